@@ -0,0 +1,607 @@
+#ifdef __linux__
+#define _XOPEN_SOURCE 700
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "Error.h"
+#include "LC3.h"
+#include "Memory.h"
+#include "OptParse.h"
+#include "Parser.h"
+
+#ifndef BENCH_PATH
+#error "No Path has been supplied for the benchmark programs."
+#endif
+
+#define STR(x) #x
+#define BENCHPATH(path) STR(path)
+
+// Stops a workload that never halts from hanging the whole benchmark.
+#define INSTRUCTION_LIMIT 1000000000ULL
+
+#define MAX_OUTPUT 4096
+
+// Every word of memory is disassembled.
+#define MEMORY_WORDS 0x10000
+
+// What the Operating System prints when a program halts.
+#define HALTED "\n\n--- Halting the LC-3 ---\n\n"
+
+/*
+ * How many times each measured operation is repeated inside a single sample.
+ * These are fixed so that results are comparable between runs.
+ */
+
+#define ASSEMBLE_ITERATIONS    20
+#define LOAD_ITERATIONS       200
+#define DISASSEMBLE_ITERATIONS  4
+
+struct workload {
+        char const *name;
+        char const *source;
+        char const *input;
+        char const *output;
+};
+
+static struct workload const workloads[] = {
+        {
+                .name   = "Compare",
+                .source = BENCHPATH(BENCH_PATH) "/Examples/Compare.asm",
+                .input  = "-123\n45\n",
+                .output = "-123\n45\n-1" HALTED,
+        },
+        {
+                .name   = "Fibonacci",
+                .source = BENCHPATH(BENCH_PATH) "/Examples/Fibonacci.asm",
+                .input  = "23\n",
+                .output = "\nEnter a number from 3 to 23: 23\n"
+                          "1 1 2 3 5 8 13 21 34 55 89 144 233 377 610 987 1597 "
+                          "2584 4181 6765 10946 17711 28657 " HALTED,
+        },
+        {
+                .name   = "Recursive_Fibonacci",
+                .source = BENCHPATH(BENCH_PATH) "/Examples/Recursive_Fibonacci.asm",
+                .input  = "23\n",
+                .output = "\nEnter a number from 3 to 23: 23\n"
+                          "1 1 2 3 5 8 13 21 34 55 89 144 233 377 610 987 1597 "
+                          "2584 4181 6765 10946 17711 28657 " HALTED,
+        },
+        {
+                .name   = "Sort",
+                .source = BENCHPATH(BENCH_PATH) "/bench/programs/Sort.asm",
+                .input  = "",
+                .output = "                 AAABBCCDDDEEEEEFFGGHHHIIIIJJKKLLMMNNNOOOOOOOPPQQRRRSSTTTUUUUVVWWXXYYZZ\n" HALTED,
+        },
+        {
+                .name   = "Sieve",
+                .source = BENCHPATH(BENCH_PATH) "/bench/programs/Sieve.asm",
+                .input  = "",
+                .output = "168\n" HALTED,
+        },
+        {
+                .name   = "Strings",
+                .source = BENCHPATH(BENCH_PATH) "/bench/programs/Strings.asm",
+                .input  = "",
+                .output = ".god yzal eht revo spmuj xof nworb kciuq ehT .SGNIRTS PU DEKCAB SKROW ti fi KCEHC\n16\n" HALTED,
+        },
+        {
+                .name   = "MatrixMultiply",
+                .source = BENCHPATH(BENCH_PATH) "/bench/programs/MatrixMultiply.asm",
+                .input  = "",
+                .output = "3144\n390\n" HALTED,
+        },
+};
+
+/*
+ * The keyboard and display of a simulator that isn't attached to a terminal.
+ */
+
+struct buffer {
+        char const *input;
+        size_t read;
+        char output[MAX_OUTPUT];
+        size_t written;
+};
+
+struct result {
+        char name[64];
+        char const *unit;
+        unsigned long long work;
+        int iterations;
+        double *samples;
+        bool verified;
+};
+
+static struct program program;
+static int repeats = 5;
+
+static int bufferRead(void *data)
+{
+        struct buffer *buffer = data;
+
+        if ('\0' == buffer->input[buffer->read]) {
+                return 0;
+        }
+
+        return (unsigned char) buffer->input[buffer->read++];
+}
+
+static void bufferWrite(void *data, char c)
+{
+        struct buffer *buffer = data;
+
+        if (buffer->written < MAX_OUTPUT - 1) {
+                buffer->output[buffer->written++] = c;
+                buffer->output[buffer->written] = '\0';
+        }
+}
+
+static double now(void)
+{
+        struct timespec time;
+
+        clock_gettime(CLOCK_MONOTONIC, &time);
+
+        return (double) time.tv_sec + (double) time.tv_nsec / 1e9;
+}
+
+/*
+ * Copy a string into freshly allocated memory, as the program struct expects
+ * to own all of its file names.
+ */
+
+static char *copyOf(char const *string)
+{
+        char *copy = strdup(string);
+
+        if (NULL == copy) {
+                perror("lc3bench");
+                exit(EXIT_FAILURE);
+        }
+
+        return copy;
+}
+
+static char *pathFor(char const *directory, char const *name,
+                     char const *extension)
+{
+        size_t length = strlen(directory) + strlen(name) + strlen(extension) + 2;
+        char *path = malloc(length);
+
+        if (NULL == path) {
+                perror("lc3bench");
+                exit(EXIT_FAILURE);
+        }
+
+        snprintf(path, length, "%s/%s%s", directory, name, extension);
+
+        return path;
+}
+
+static void setUp(struct workload const *workload, char const *directory)
+{
+        program = (struct program) {
+                .assemblyfile = copyOf(workload->source),
+                .objectfile   = pathFor(directory, workload->name, ".obj"),
+                .symbolfile   = pathFor(directory, workload->name, ".sym"),
+                .hexoutfile   = pathFor(directory, workload->name, ".hex"),
+                .binoutfile   = pathFor(directory, workload->name, ".bin"),
+                .warn         = false,
+        };
+}
+
+static void tearDown(void)
+{
+        tidyUp(&program);
+}
+
+static void reset(void)
+{
+        memset(&program.simulator, 0, sizeof(program.simulator));
+        program.simulator.CC = 'Z';
+}
+
+static unsigned long long countLines(char const *file)
+{
+        unsigned long long lines = 0;
+        int c;
+        FILE *source = fopen(file, "r");
+
+        if (NULL == source) {
+                perror("lc3bench");
+                exit(EXIT_FAILURE);
+        }
+
+        while (EOF != (c = fgetc(source))) {
+                lines += '\n' == c;
+        }
+
+        fclose(source);
+
+        return lines;
+}
+
+/*
+ * parse() reports its progress as it goes, which would end up mixed in with
+ * the results, so it is sent to /dev/null while we time it.
+ */
+
+static bool quietParse(void)
+{
+        bool assembled;
+
+        program.messages = fopen("/dev/null", "w");
+        if (NULL == program.messages) {
+                perror("lc3bench");
+                exit(EXIT_FAILURE);
+        }
+
+        assembled = parse(&program);
+
+        fclose(program.messages);
+        program.messages = NULL;
+        freeTable(&program);
+
+        return assembled;
+}
+
+static bool benchAssemble(struct result *result)
+{
+        double start;
+
+        result->work = countLines(program.assemblyfile);
+        result->iterations = ASSEMBLE_ITERATIONS;
+        result->unit = "lines/s";
+
+        for (int sample = 0; sample < repeats; ++sample) {
+                start = now();
+                for (int i = 0; i < ASSEMBLE_ITERATIONS; ++i) {
+                        if (!quietParse()) {
+                                return false;
+                        }
+                }
+                result->samples[sample] = (double) (result->work *
+                        ASSEMBLE_ITERATIONS) / (now() - start);
+        }
+
+        return true;
+}
+
+static void benchLoad(struct result *result)
+{
+        double start;
+
+        result->work = 1;
+        result->iterations = LOAD_ITERATIONS;
+        result->unit = "us";
+
+        for (int sample = 0; sample < repeats; ++sample) {
+                start = now();
+                for (int i = 0; i < LOAD_ITERATIONS; ++i) {
+                        populateMemory(&program);
+                }
+                result->samples[sample] = (now() - start) * 1e6 / LOAD_ITERATIONS;
+        }
+}
+
+static bool benchSimulate(struct result *result, struct workload const *workload)
+{
+        double start;
+        unsigned long long executed;
+        struct buffer buffer;
+        struct console const console = {
+                .read  = bufferRead,
+                .write = bufferWrite,
+                .data  = &buffer,
+        };
+
+        result->iterations = 1;
+        result->unit = "MIPS";
+        result->verified = true;
+
+        reset();
+        populateMemory(&program);
+        snapshotMachine(&program);
+
+        for (int sample = 0; sample < repeats; ++sample) {
+                buffer = (struct buffer) {
+                        .input = workload->input,
+                };
+
+                resetMachine(&program);
+
+                executed = 0;
+                start = now();
+                while (!program.simulator.isHalted &&
+                       executed < INSTRUCTION_LIMIT) {
+                        step(&program.simulator, &console);
+                        executed++;
+                }
+                result->samples[sample] = (double) executed / (now() - start) / 1e6;
+                result->work = executed;
+
+                // Programs given on the command line only have to halt.
+                if (!program.simulator.isHalted || (NULL != workload->output &&
+                    strcmp(buffer.output, workload->output))) {
+                        fprintf(stderr, "%s: unexpected output:\n%s\n",
+                                workload->name, buffer.output);
+                        result->verified = false;
+                }
+        }
+
+        return result->verified;
+}
+
+static void benchDisassemble(struct result *result)
+{
+        double start;
+
+        result->work = MEMORY_WORDS;
+        result->iterations = DISASSEMBLE_ITERATIONS;
+        result->unit = "words/s";
+
+        for (int sample = 0; sample < repeats; ++sample) {
+                start = now();
+                for (int i = 0; i < DISASSEMBLE_ITERATIONS; ++i) {
+                        for (uint32_t address = 0; address < MEMORY_WORDS;
+                             ++address) {
+                                // Like the memory view, start with a clean
+                                // buffer.
+                                char buff[100] = { 0 };
+                                disassemble(&program, (uint16_t) address,
+                                            buff);
+                        }
+                }
+                result->samples[sample] =
+                        (double) (MEMORY_WORDS * DISASSEMBLE_ITERATIONS) /
+                        (now() - start);
+        }
+}
+
+static void writeResult(FILE *file, struct result const *result, bool last)
+{
+        double mean = 0.0, variance = 0.0;
+        double min = result->samples[0], max = result->samples[0];
+
+        for (int i = 0; i < repeats; ++i) {
+                mean += result->samples[i];
+                min = result->samples[i] < min ? result->samples[i] : min;
+                max = result->samples[i] > max ? result->samples[i] : max;
+        }
+        mean /= repeats;
+
+        for (int i = 0; i < repeats; ++i) {
+                variance += (result->samples[i] - mean) * (result->samples[i] - mean);
+        }
+        variance = repeats > 1 ? variance / (repeats - 1) : 0.0;
+
+        fprintf(file, "    {\n");
+        fprintf(file, "      \"name\": \"%s\",\n", result->name);
+        fprintf(file, "      \"unit\": \"%s\",\n", result->unit);
+        fprintf(file, "      \"work\": %llu,\n", result->work);
+        fprintf(file, "      \"iterations\": %d,\n", result->iterations);
+        fprintf(file, "      \"repeats\": %d,\n", repeats);
+        fprintf(file, "      \"verified\": %s,\n", result->verified ? "true" : "false");
+        fprintf(file, "      \"mean\": %.3f,\n", mean);
+        fprintf(file, "      \"min\": %.3f,\n", min);
+        fprintf(file, "      \"max\": %.3f,\n", max);
+        fprintf(file, "      \"stddev\": %.3f,\n", sqrt(variance));
+        fprintf(file, "      \"variance\": %.3f\n", variance);
+        fprintf(file, "    }%s\n", last ? "" : ",");
+}
+
+__attribute__((noreturn)) static void usage(char const *const name)
+{
+        printf("Usage: %s [options]                                               \n\n"
+                        "Options:                                                    \n"
+                        "  -r [--repeats] <count> Number of samples per benchmark.  \n"
+                        "  -o [--output] file     Write the JSON results to file.    \n"
+                        "  -d [--directory] dir   Where to write assembled programs. \n"
+                        "  -f [--filter] name     Only run workloads matching name.  \n"
+                        "  -p [--program] file    Also benchmark the given program.  \n",
+                name
+        );
+
+        exit(EXIT_SUCCESS);
+}
+
+/*
+ * Make a workload out of a program given on the command line, named after the
+ * file it came from.
+ */
+
+static struct workload workloadFor(char const *file)
+{
+        char const *base = strrchr(file, '/');
+        char *name = copyOf(NULL == base ? file : base + 1);
+        char *ext = strrchr(name, '.');
+
+        if (NULL != ext) {
+                *ext = '\0';
+        }
+
+        return (struct workload) {
+                .name   = name,
+                .source = file,
+                .input  = "",
+                .output = NULL,
+        };
+}
+
+int main(int argc, char **argv)
+{
+        size_t const builtin = sizeof(workloads) / sizeof(*workloads);
+        size_t count = builtin;
+        struct workload *all = calloc(builtin + (size_t) argc, sizeof(*all));
+        struct result *results = calloc(4 * (builtin + (size_t) argc),
+                                        sizeof(*results));
+        size_t produced = 0;
+        char const *output = NULL, *directory = ".", *filter = NULL;
+        char *end = NULL;
+        int option, failed = 0;
+        FILE *file = stdout;
+
+        options _options[] = {
+                {
+                        .longOption = "repeats",
+                        .shortOption = 'r',
+                        .option = REQUIRED,
+                },
+                {
+                        .longOption = "output",
+                        .shortOption = 'o',
+                        .option = REQUIRED,
+                },
+                {
+                        .longOption = "directory",
+                        .shortOption = 'd',
+                        .option = REQUIRED,
+                },
+                {
+                        .longOption = "filter",
+                        .shortOption = 'f',
+                        .option = REQUIRED,
+                },
+                {
+                        .longOption = "program",
+                        .shortOption = 'p',
+                        .option = REQUIRED,
+                },
+                {
+                        .longOption = "help",
+                        .shortOption = 'h',
+                        .option = NONE,
+                },
+                {
+                        NULL, '\0', NONE,
+                },
+        };
+
+        if (NULL == all || NULL == results) {
+                perror("lc3bench");
+                exit(EXIT_FAILURE);
+        }
+
+        memcpy(all, workloads, sizeof(workloads));
+
+        while ((option = parseOptions(_options, argc, argv)) != 0) {
+                if (('r' == option || 'o' == option || 'd' == option ||
+                     'f' == option || 'p' == option) &&
+                    returnedOption.option == NONE) {
+                        fprintf(stderr, "Option -%c requires an argument.\n", option);
+                        exit(EXIT_FAILURE);
+                }
+
+                switch (option) {
+                case 'r':
+                        repeats = (int) strtol(returnedOption.longOption, &end, 10);
+                        if (*end || repeats < 1) {
+                                fprintf(stderr, "Invalid repeat count: %s\n",
+                                        returnedOption.longOption);
+                                exit(EXIT_FAILURE);
+                        }
+                        break;
+                case 'o':
+                        output = returnedOption.longOption;
+                        break;
+                case 'd':
+                        directory = returnedOption.longOption;
+                        break;
+                case 'f':
+                        filter = returnedOption.longOption;
+                        break;
+                case 'p':
+                        all[count++] = workloadFor(returnedOption.longOption);
+                        break;
+                case 'h':
+                        usage(argv[0]);
+                default:
+                        fprintf(stderr, "Invalid opt: %s\n",
+                                NULL != returnedOption.longOption ?
+                                returnedOption.longOption : argv[0]);
+                        exit(EXIT_FAILURE);
+                }
+        }
+
+        for (size_t i = 0; i < 4 * count; ++i) {
+                results[i].samples = calloc((size_t) repeats, sizeof(double));
+                results[i].verified = true;
+                if (NULL == results[i].samples) {
+                        perror("lc3bench");
+                        exit(EXIT_FAILURE);
+                }
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+                struct workload const *workload = &all[i];
+                struct result *result = &results[produced];
+
+                if (NULL != filter && NULL == strstr(workload->name, filter)) {
+                        continue;
+                }
+
+                setUp(workload, directory);
+
+                snprintf(result->name, sizeof(result->name), "assemble/%s",
+                         workload->name);
+                if (!benchAssemble(result)) {
+                        fprintf(stderr, "%s: failed to assemble.\n", workload->name);
+                        tearDown();
+                        failed++;
+                        continue;
+                }
+                result++;
+
+                snprintf(result->name, sizeof(result->name), "load/%s",
+                         workload->name);
+                benchLoad(result++);
+
+                snprintf(result->name, sizeof(result->name), "simulate/%s",
+                         workload->name);
+                failed += !benchSimulate(result++, workload);
+
+                snprintf(result->name, sizeof(result->name), "disassemble/%s",
+                         workload->name);
+                benchDisassemble(result++);
+
+                produced = (size_t) (result - results);
+                tearDown();
+        }
+
+        if (NULL != output && NULL == (file = fopen(output, "w"))) {
+                perror("lc3bench");
+                exit(EXIT_FAILURE);
+        }
+
+        fprintf(file, "{\n");
+        fprintf(file, "  \"benchmark\": \"lc3bench\",\n");
+        fprintf(file, "  \"repeats\": %d,\n", repeats);
+        fprintf(file, "  \"results\": [\n");
+        for (size_t i = 0; i < produced; ++i) {
+                writeResult(file, &results[i], i + 1 == produced);
+        }
+        fprintf(file, "  ]\n");
+        fprintf(file, "}\n");
+
+        if (stdout != file) {
+                fclose(file);
+        }
+
+        for (size_t i = 0; i < 4 * count; ++i) {
+                free(results[i].samples);
+        }
+
+        for (size_t i = builtin; i < count; ++i) {
+                free((char *) all[i].name);
+        }
+
+        free(results);
+        free(all);
+
+        return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,357 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "OptParse.h"
+
+/*
+ * Generates LC-3 assembly programs of any size and shape, to find out where the
+ * assembler and simulator stop scaling.
+ *
+ * The program is made up of blocks, each of which is laid out as:
+ *
+ *	SECTION_n	BRnzp BODY_n		; Jump over the data
+ *	TEXT_n_m	.STRINGZ "..."		; --strings of these
+ *	SPACE_n_m	.BLKW ...		; --blkw of these
+ *	VALUE_n		.FILL #trips
+ *	BODY_n		; --comments lines of comments
+ *			LD R1, VALUE_n		; --references of these, either
+ *			LEA R3, SECTION_n+1	; backwards or forwards
+ *			LD R4, VALUE_n		; A loop of #trips iterations
+ *	LOOP_n		ADD R2, R2, #1
+ *			ADD R4, R4, #-1
+ *			BRp LOOP_n
+ *
+ * with each block falling through to the next. Before the first block there is
+ * a chain of --depth subroutines, each calling the next, which is called once
+ * at the start. After the last block the program prints DONE and halts.
+ */
+
+// The first address of the device registers, which a program can't run into.
+#define DEVICE_REGISTERS 0xFE00
+#define ORIGIN           0x3000
+
+// The limits the assembler puts on a single directive.
+#define MAX_STRING_LENGTH 99
+#define MAX_BLKW_SIZE    149
+
+struct shape {
+        long blocks;
+        long strings;
+        long stringLength;
+        long blkw;
+        long blkwSize;
+        long references;
+        long forward;
+        long comments;
+        long trips;
+        long depth;
+        unsigned long seed;
+};
+
+static unsigned long state;
+
+/*
+ * A small generator of our own, so that the same seed gives the same program
+ * on every platform.
+ */
+
+static unsigned long next(void)
+{
+        state = state * 6364136223846793005UL + 1442695040888963407UL;
+
+        return (state >> 33) & 0x7fffffffUL;
+}
+
+static long wordsPerBlock(struct shape const *shape)
+{
+        return 1 + shape->strings * (shape->stringLength + 1) +
+               shape->blkw * shape->blkwSize + 1 + shape->references +
+               (shape->trips ? 4 : 0);
+}
+
+static void writeString(FILE *file, long length)
+{
+        static char const characters[] =
+                "ABCDEFGHIJKLMNOPQRSTUVWXYZ abcdefghijklmnopqrstuvwxyz ";
+
+        fputc('"', file);
+        for (long i = 0; i < length; ++i) {
+                fputc(characters[next() % (sizeof(characters) - 1)], file);
+        }
+        fputc('"', file);
+}
+
+static void writeChain(FILE *file, struct shape const *shape)
+{
+        fprintf(file, "; A chain of %ld subroutines, each calling the next\n",
+                shape->depth);
+
+        for (long i = 0; i < shape->depth; ++i) {
+                fprintf(file, "CHAIN_%ld\n", i);
+                if (i + 1 == shape->depth) {
+                        fprintf(file, "\tADD R2, R2, #1\n");
+                        fprintf(file, "\tRET\n");
+                        break;
+                }
+
+                fprintf(file, "\tST R7, SAVE_%ld\t\t; Save the return address\n", i);
+                fprintf(file, "\tJSR CHAIN_%ld\n", i + 1);
+                fprintf(file, "\tLD R7, SAVE_%ld\n", i);
+                fprintf(file, "\tRET\n");
+                fprintf(file, "SAVE_%ld\t.BLKW 1\n", i);
+        }
+
+        fputc('\n', file);
+}
+
+static void writeBlock(FILE *file, struct shape const *shape, long block)
+{
+        fprintf(file, "SECTION_%ld\n", block);
+        fprintf(file, "\tBRnzp BODY_%ld\t\t; Jump over the data\n", block);
+
+        for (long i = 0; i < shape->strings; ++i) {
+                fprintf(file, "TEXT_%ld_%ld\t.STRINGZ ", block, i);
+                writeString(file, shape->stringLength);
+                fputc('\n', file);
+        }
+
+        for (long i = 0; i < shape->blkw; ++i) {
+                fprintf(file, "SPACE_%ld_%ld\t.BLKW #%ld\n", block, i,
+                        shape->blkwSize);
+        }
+
+        fprintf(file, "VALUE_%ld\t.FILL #%ld\n", block, shape->trips);
+        fprintf(file, "BODY_%ld\n", block);
+
+        for (long i = 0; i < shape->comments; ++i) {
+                fprintf(file, "\t; Comment %ld of block %ld, which the "
+                        "assembler has to skip over\n", i, block);
+        }
+
+        for (long i = 0; i < shape->references; ++i) {
+                if ((long) (next() % 100) < shape->forward) {
+                        if (block + 1 == shape->blocks) {
+                                fprintf(file, "\tLEA R3, FINISH\n");
+                        } else {
+                                fprintf(file, "\tLEA R3, SECTION_%ld\n", block + 1);
+                        }
+                } else {
+                        fprintf(file, "\tLD R1, VALUE_%ld\n", block);
+                }
+        }
+
+        if (shape->trips) {
+                fprintf(file, "\tLD R4, VALUE_%ld\t\t; Loop #%ld times\n",
+                        block, shape->trips);
+                fprintf(file, "LOOP_%ld\tADD R2, R2, #1\n", block);
+                fprintf(file, "\tADD R4, R4, #-1\n");
+                fprintf(file, "\tBRp LOOP_%ld\n", block);
+        }
+
+        fputc('\n', file);
+}
+
+static void generate(FILE *file, struct shape const *shape)
+{
+        state = shape->seed;
+
+        fprintf(file, ";\n");
+        fprintf(file, "; Generated by lc3gen --blocks %ld --strings %ld "
+                "--string-length %ld --blkw %ld --blkw-size %ld\n",
+                shape->blocks, shape->strings, shape->stringLength, shape->blkw,
+                shape->blkwSize);
+        fprintf(file, ";     --references %ld --forward %ld --comments %ld "
+                "--trips %ld --depth %ld --seed %lu\n",
+                shape->references, shape->forward, shape->comments,
+                shape->trips, shape->depth, shape->seed);
+        fprintf(file, ";\n\n");
+
+        fprintf(file, ".ORIG x%04X\n\n", ORIGIN);
+
+        // The chain can be too long to branch over, so jump to the first block
+        // through its address instead.
+        if (shape->depth) {
+                fprintf(file, "\tJSR CHAIN_0\n");
+        }
+        fprintf(file, "\tLD R5, START\n");
+        fprintf(file, "\tJMP R5\n");
+        fprintf(file, "START\t.FILL SECTION_0\n\n");
+
+        if (shape->depth) {
+                writeChain(file, shape);
+        }
+
+        for (long block = 0; block < shape->blocks; ++block) {
+                writeBlock(file, shape, block);
+        }
+
+        fprintf(file, "FINISH\n");
+        fprintf(file, "\tLEA R0, DONE\n");
+        fprintf(file, "\tPUTS\n");
+        fprintf(file, "\tHALT\n");
+        fprintf(file, "DONE\t.STRINGZ \"DONE\\n\"\n\n");
+        fprintf(file, ".END\n");
+}
+
+__attribute__((noreturn)) static void usage(char const *const name)
+{
+        printf("Usage: %s [options]                                                  \n\n"
+                        "Options:                                                        \n"
+                        "  -b [--blocks] <count>        Number of blocks (default 25).   \n"
+                        "  -s [--strings] <count>       .STRINGZ lines per block.        \n"
+                        "  -l [--string-length] <count> Characters in each .STRINGZ.     \n"
+                        "  -w [--blkw] <count>          .BLKW lines per block.           \n"
+                        "  -z [--blkw-size] <count>     Words reserved by each .BLKW.    \n"
+                        "  -r [--references] <count>    Label references per block.      \n"
+                        "  -F [--forward] <percent>     How many references are forward. \n"
+                        "  -c [--comments] <count>      Comment lines per block.         \n"
+                        "  -t [--trips] <count>         Iterations of each block's loop. \n"
+                        "  -d [--depth] <count>         Length of the JSR call chain.    \n"
+                        "  -S [--seed] <number>         Seed for the generated text.     \n"
+                        "  -o [--output] file           Where to write the program.      \n",
+                name
+        );
+
+        exit(EXIT_SUCCESS);
+}
+
+static long number(char const *option, long min, long max)
+{
+        char *end = NULL;
+        long value;
+
+        if (returnedOption.option == NONE) {
+                fprintf(stderr, "Option --%s requires a number.\n", option);
+                exit(EXIT_FAILURE);
+        }
+
+        value = strtol(returnedOption.longOption, &end, 10);
+        if (*end || value < min || value > max) {
+                fprintf(stderr, "Option --%s needs a number between %ld and %ld.\n",
+                        option, min, max);
+                exit(EXIT_FAILURE);
+        }
+
+        return value;
+}
+
+int main(int argc, char **argv)
+{
+        struct shape shape = {
+                .blocks       = 25,
+                .strings      = 1,
+                .stringLength = 16,
+                .blkw         = 1,
+                .blkwSize     = 8,
+                .references   = 4,
+                .forward      = 50,
+                .comments     = 1,
+                .trips        = 10,
+                .depth        = 16,
+                .seed         = 1,
+        };
+        char const *output = NULL;
+        FILE *file = stdout;
+        int option;
+
+        options _options[] = {
+                { .longOption = "blocks",        .shortOption = 'b', .option = REQUIRED, },
+                { .longOption = "strings",       .shortOption = 's', .option = REQUIRED, },
+                { .longOption = "string-length", .shortOption = 'l', .option = REQUIRED, },
+                { .longOption = "blkw",          .shortOption = 'w', .option = REQUIRED, },
+                { .longOption = "blkw-size",     .shortOption = 'z', .option = REQUIRED, },
+                { .longOption = "references",    .shortOption = 'r', .option = REQUIRED, },
+                { .longOption = "forward",       .shortOption = 'F', .option = REQUIRED, },
+                { .longOption = "comments",      .shortOption = 'c', .option = REQUIRED, },
+                { .longOption = "trips",         .shortOption = 't', .option = REQUIRED, },
+                { .longOption = "depth",         .shortOption = 'd', .option = REQUIRED, },
+                { .longOption = "seed",          .shortOption = 'S', .option = REQUIRED, },
+                { .longOption = "output",        .shortOption = 'o', .option = REQUIRED, },
+                { .longOption = "help",          .shortOption = 'h', .option = NONE, },
+                { NULL, '\0', NONE, },
+        };
+
+        while ((option = parseOptions(_options, argc, argv)) != 0) {
+                switch (option) {
+                case 'b':
+                        shape.blocks = number("blocks", 1, DEVICE_REGISTERS);
+                        break;
+                case 's':
+                        shape.strings = number("strings", 0, DEVICE_REGISTERS);
+                        break;
+                case 'l':
+                        shape.stringLength = number("string-length", 1,
+                                MAX_STRING_LENGTH);
+                        break;
+                case 'w':
+                        shape.blkw = number("blkw", 0, DEVICE_REGISTERS);
+                        break;
+                case 'z':
+                        shape.blkwSize = number("blkw-size", 1, MAX_BLKW_SIZE);
+                        break;
+                case 'r':
+                        shape.references = number("references", 0, 200);
+                        break;
+                case 'F':
+                        shape.forward = number("forward", 0, 100);
+                        break;
+                case 'c':
+                        shape.comments = number("comments", 0, 1000000);
+                        break;
+                case 't':
+                        shape.trips = number("trips", 0, 0x7fff);
+                        break;
+                case 'd':
+                        shape.depth = number("depth", 0, 0x1000);
+                        break;
+                case 'S':
+                        shape.seed = (unsigned long) number("seed", 0, 0x7fffffffL);
+                        break;
+                case 'o':
+                        if (returnedOption.option == NONE) {
+                                fprintf(stderr, "Option --output requires a file.\n");
+                                exit(EXIT_FAILURE);
+                        }
+                        output = returnedOption.longOption;
+                        break;
+                case 'h':
+                        usage(argv[0]);
+                default:
+                        fprintf(stderr, "Invalid opt: %s\n",
+                                NULL != returnedOption.longOption ?
+                                returnedOption.longOption : argv[0]);
+                        exit(EXIT_FAILURE);
+                }
+        }
+
+        // BRnzp has to be able to reach over the data at the top of each block.
+        if (shape.strings * (shape.stringLength + 1) + shape.blkw * shape.blkwSize
+            > 254) {
+                fprintf(stderr, "Too much data in each block to branch over.\n");
+                exit(EXIT_FAILURE);
+        }
+
+        // Everything has to fit between the origin and the device registers,
+        // including the chain, and what comes after the last block.
+        if (4 + 5 * shape.depth + shape.blocks * wordsPerBlock(&shape) + 8 >
+            DEVICE_REGISTERS - ORIGIN) {
+                fprintf(stderr, "A program of this shape doesn't fit in memory "
+                        "(%ld words per block).\n", wordsPerBlock(&shape));
+                exit(EXIT_FAILURE);
+        }
+
+        if (NULL != output && NULL == (file = fopen(output, "w"))) {
+                perror("lc3gen");
+                exit(EXIT_FAILURE);
+        }
+
+        generate(file, &shape);
+
+        if (stdout != file) {
+                fclose(file);
+        }
+
+        return 0;
+}
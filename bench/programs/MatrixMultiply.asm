@@ -0,0 +1,316 @@
+;
+; Multiplies two 8x8 matrices together, and prints the sum of every element of
+; the result, followed by its trace. The multiplication is repeated PASSES
+; times, so that the program runs long enough to be timed.
+;
+; Expected output:
+; 3144
+; 390
+;
+
+; R0 -- Running total of the current element
+; R1 -- Element of the row of A
+; R2 -- Element of the column of B, used as a counter to multiply
+; R3 -- Temporary value
+; R4 -- Pointer along the row of A
+; R5 -- Pointer down the column of B
+; R6 -- Elements left in the current row / column
+
+.ORIG x3000
+
+	LD R0, PASSES		; Load how many times to multiply the matrices
+	ST R0, PASS_COUNT
+
+MULTIPLY_AGAIN
+	LEA R0, A_MATRIX	; Start at the first row of A
+	ST R0, ROW_A
+	LEA R0, C_MATRIX	; And the first element of C
+	ST R0, C_POINTER
+	AND R0, R0, #0
+	ADD R0, R0, #8
+	ST R0, ROWS_LEFT
+
+; Move on to the next row of A
+ROW_LOOP
+	LEA R0, B_MATRIX	; Start at the first column of B
+	ST R0, COLUMN_B
+	AND R0, R0, #0
+	ADD R0, R0, #8
+	ST R0, COLUMNS_LEFT
+
+; Find the dot product of the current row of A and column of B
+COLUMN_LOOP
+	LD R4, ROW_A
+	LD R5, COLUMN_B
+	AND R6, R6, #0
+	ADD R6, R6, #8
+	AND R0, R0, #0
+DOT_LOOP
+	LDR R1, R4, #0		; Load the two elements
+	LDR R2, R5, #0
+	BRz DOT_NEXT		; Nothing to add if either is zero
+MULTIPLY
+	ADD R0, R0, R1		; Multiply them by repeatedly adding
+	ADD R2, R2, #-1
+	BRp MULTIPLY
+DOT_NEXT
+	ADD R4, R4, #1		; Next element along the row
+	ADD R5, R5, #8		; Next element down the column
+	ADD R6, R6, #-1
+	BRp DOT_LOOP
+
+	LD R3, C_POINTER	; Store the result in C
+	STR R0, R3, #0
+	ADD R3, R3, #1
+	ST R3, C_POINTER
+	LD R3, COLUMN_B		; Move to the next column
+	ADD R3, R3, #1
+	ST R3, COLUMN_B
+	LD R3, COLUMNS_LEFT
+	ADD R3, R3, #-1
+	ST R3, COLUMNS_LEFT
+	BRp COLUMN_LOOP
+
+	LD R3, ROW_A		; Move to the next row
+	ADD R3, R3, #8
+	ST R3, ROW_A
+	LD R3, ROWS_LEFT
+	ADD R3, R3, #-1
+	ST R3, ROWS_LEFT
+	BRp ROW_LOOP
+
+	LD R3, PASS_COUNT	; Multiply them again
+	ADD R3, R3, #-1
+	ST R3, PASS_COUNT
+	BRp MULTIPLY_AGAIN
+
+; Add up every element of C
+	LEA R1, C_MATRIX
+	AND R0, R0, #0
+	LD R2, ELEMENTS
+SUM
+	LDR R3, R1, #0
+	ADD R0, R0, R3
+	ADD R1, R1, #1
+	ADD R2, R2, #-1
+	BRp SUM
+	JSR PRINT_DECIMAL
+	LD R0, NEWLINE
+	OUT
+
+; Add up the diagonal of C
+	LEA R1, C_MATRIX
+	AND R0, R0, #0
+	AND R2, R2, #0
+	ADD R2, R2, #8
+TRACE
+	LDR R3, R1, #0
+	ADD R0, R0, R3
+	ADD R1, R1, #9
+	ADD R2, R2, #-1
+	BRp TRACE
+	JSR PRINT_DECIMAL
+	LD R0, NEWLINE
+	OUT
+	HALT
+
+PASSES		.FILL #200
+PASS_COUNT	.BLKW 1
+ROWS_LEFT	.BLKW 1
+COLUMNS_LEFT	.BLKW 1
+ROW_A		.BLKW 1
+COLUMN_B	.BLKW 1
+C_POINTER	.BLKW 1
+ELEMENTS	.FILL #64
+NEWLINE		.FILL x0A
+
+; --------------------------------------------------------------
+; Print the value in R0 (0 to 32767) in decimal, without any
+; leading zeroes. All registers except R0 are preserved.
+; --------------------------------------------------------------
+PRINT_DECIMAL
+	ST R1, PD_R1		; Save the registers we use
+	ST R2, PD_R2
+	ST R3, PD_R3
+	ST R4, PD_R4
+	ST R7, PD_R7
+	ADD R1, R0, #0		; R1 holds what is left to print
+	LEA R2, PD_POWERS	; R2 walks the table of powers of ten
+	AND R4, R4, #0		; R4 becomes positive once a digit is printed
+PD_NEXT_POWER
+	LDR R3, R2, #0		; Load the next power of ten
+	BRz PD_UNITS		; The table ends with a zero
+	NOT R3, R3		; Negate it
+	ADD R3, R3, #1
+	AND R0, R0, #0		; R0 counts how many times it fits
+PD_SUBTRACT
+	ADD R1, R1, R3
+	BRn PD_RESTORE
+	ADD R0, R0, #1
+	BRnzp PD_SUBTRACT
+PD_RESTORE
+	NOT R3, R3		; Undo the last subtraction
+	ADD R3, R3, #1
+	ADD R1, R1, R3
+	ADD R4, R4, R0		; Skip any leading zeroes
+	BRz PD_SKIP
+	LD R3, PD_ZERO
+	ADD R0, R0, R3
+	OUT
+PD_SKIP
+	ADD R2, R2, #1
+	BRnzp PD_NEXT_POWER
+PD_UNITS
+	LD R3, PD_ZERO		; The units are always printed
+	ADD R0, R1, R3
+	OUT
+	LD R1, PD_R1		; Restore the registers
+	LD R2, PD_R2
+	LD R3, PD_R3
+	LD R4, PD_R4
+	LD R7, PD_R7
+	RET
+
+PD_POWERS	.FILL #10000
+		.FILL #1000
+		.FILL #100
+		.FILL #10
+		.FILL #0
+PD_ZERO		.FILL x30
+PD_R1		.BLKW 1
+PD_R2		.BLKW 1
+PD_R3		.BLKW 1
+PD_R4		.BLKW 1
+PD_R7		.BLKW 1
+
+A_MATRIX	.FILL #1
+	.FILL #0
+	.FILL #5
+	.FILL #4
+	.FILL #3
+	.FILL #2
+	.FILL #1
+	.FILL #0
+	.FILL #4
+	.FILL #3
+	.FILL #2
+	.FILL #1
+	.FILL #0
+	.FILL #5
+	.FILL #4
+	.FILL #3
+	.FILL #1
+	.FILL #0
+	.FILL #5
+	.FILL #4
+	.FILL #3
+	.FILL #2
+	.FILL #1
+	.FILL #0
+	.FILL #4
+	.FILL #3
+	.FILL #2
+	.FILL #1
+	.FILL #0
+	.FILL #5
+	.FILL #4
+	.FILL #3
+	.FILL #1
+	.FILL #0
+	.FILL #5
+	.FILL #4
+	.FILL #3
+	.FILL #2
+	.FILL #1
+	.FILL #0
+	.FILL #4
+	.FILL #3
+	.FILL #2
+	.FILL #1
+	.FILL #0
+	.FILL #5
+	.FILL #4
+	.FILL #3
+	.FILL #1
+	.FILL #0
+	.FILL #5
+	.FILL #4
+	.FILL #3
+	.FILL #2
+	.FILL #1
+	.FILL #0
+	.FILL #4
+	.FILL #3
+	.FILL #2
+	.FILL #1
+	.FILL #0
+	.FILL #5
+	.FILL #4
+	.FILL #3
+B_MATRIX	.FILL #3
+	.FILL #5
+	.FILL #1
+	.FILL #3
+	.FILL #5
+	.FILL #1
+	.FILL #3
+	.FILL #5
+	.FILL #4
+	.FILL #0
+	.FILL #2
+	.FILL #4
+	.FILL #0
+	.FILL #2
+	.FILL #4
+	.FILL #0
+	.FILL #5
+	.FILL #1
+	.FILL #3
+	.FILL #5
+	.FILL #1
+	.FILL #3
+	.FILL #5
+	.FILL #1
+	.FILL #0
+	.FILL #2
+	.FILL #4
+	.FILL #0
+	.FILL #2
+	.FILL #4
+	.FILL #0
+	.FILL #2
+	.FILL #1
+	.FILL #3
+	.FILL #5
+	.FILL #1
+	.FILL #3
+	.FILL #5
+	.FILL #1
+	.FILL #3
+	.FILL #2
+	.FILL #4
+	.FILL #0
+	.FILL #2
+	.FILL #4
+	.FILL #0
+	.FILL #2
+	.FILL #4
+	.FILL #3
+	.FILL #5
+	.FILL #1
+	.FILL #3
+	.FILL #5
+	.FILL #1
+	.FILL #3
+	.FILL #5
+	.FILL #4
+	.FILL #0
+	.FILL #2
+	.FILL #4
+	.FILL #0
+	.FILL #2
+	.FILL #4
+	.FILL #0
+C_MATRIX	.BLKW #64
+
+.END
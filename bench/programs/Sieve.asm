@@ -0,0 +1,145 @@
+;
+; Counts the primes below 1000 using the Sieve of Eratosthenes, and prints how
+; many were found. The sieve is rebuilt PASSES times, so that the program runs
+; long enough to be timed.
+;
+; Expected output:
+; 168
+;
+
+; R0 -- Value being stored / the number of primes found
+; R1 -- Address of the sieve table
+; R2 -- The current prime
+; R3 -- The current multiple being crossed out
+; R4 -- Temporary value
+; R5 -- Negative of the limit
+; R6 -- Remaining passes
+
+.ORIG x3000
+
+	LD R6, PASSES		; Load how many times to build the sieve
+	LD R1, TABLE		; The table lives past the end of the program
+	LD R5, NEG_LIMIT
+
+; Mark every number as possibly prime
+SIEVE_AGAIN
+	AND R0, R0, #0
+	AND R3, R3, #0
+CLEAR
+	ADD R4, R1, R3
+	STR R0, R4, #0
+	ADD R3, R3, #1
+	ADD R4, R3, R5		; Stop at the limit
+	BRn CLEAR
+
+; Cross out the multiples of every prime below the square root of the limit
+	AND R2, R2, #0
+	ADD R2, R2, #2		; Start from 2
+NEXT_PRIME
+	ADD R4, R1, R2
+	LDR R4, R4, #0		; Skip numbers already crossed out
+	BRnp SKIP_PRIME
+	ADD R3, R2, R2		; Start from twice the prime
+CROSS_OUT
+	ADD R4, R3, R5		; Stop at the limit
+	BRzp SKIP_PRIME
+	ADD R4, R1, R3
+	AND R0, R0, #0
+	ADD R0, R0, #1
+	STR R0, R4, #0		; Cross it out
+	ADD R3, R3, R2		; Move on to the next multiple
+	BRnzp CROSS_OUT
+SKIP_PRIME
+	ADD R2, R2, #1
+	LD R4, NEG_ROOT
+	ADD R4, R2, R4
+	BRn NEXT_PRIME
+
+; Count everything that wasn't crossed out
+	AND R0, R0, #0
+	AND R3, R3, #0
+	ADD R3, R3, #2		; 0 and 1 aren't prime
+COUNT
+	ADD R4, R1, R3
+	LDR R4, R4, #0
+	BRnp NOT_PRIME
+	ADD R0, R0, #1
+NOT_PRIME
+	ADD R3, R3, #1
+	ADD R4, R3, R5		; Stop at the limit
+	BRn COUNT
+
+	ADD R6, R6, #-1		; Build it again
+	BRp SIEVE_AGAIN
+
+	JSR PRINT_DECIMAL	; Print the count
+	LD R0, NEWLINE
+	OUT
+	HALT
+
+PASSES		.FILL #100
+TABLE		.FILL x4000
+NEG_LIMIT	.FILL #-1000
+NEG_ROOT	.FILL #-32
+NEWLINE		.FILL x0A
+
+; --------------------------------------------------------------
+; Print the value in R0 (0 to 32767) in decimal, without any
+; leading zeroes. All registers except R0 are preserved.
+; --------------------------------------------------------------
+PRINT_DECIMAL
+	ST R1, PD_R1		; Save the registers we use
+	ST R2, PD_R2
+	ST R3, PD_R3
+	ST R4, PD_R4
+	ST R7, PD_R7
+	ADD R1, R0, #0		; R1 holds what is left to print
+	LEA R2, PD_POWERS	; R2 walks the table of powers of ten
+	AND R4, R4, #0		; R4 becomes positive once a digit is printed
+PD_NEXT_POWER
+	LDR R3, R2, #0		; Load the next power of ten
+	BRz PD_UNITS		; The table ends with a zero
+	NOT R3, R3		; Negate it
+	ADD R3, R3, #1
+	AND R0, R0, #0		; R0 counts how many times it fits
+PD_SUBTRACT
+	ADD R1, R1, R3
+	BRn PD_RESTORE
+	ADD R0, R0, #1
+	BRnzp PD_SUBTRACT
+PD_RESTORE
+	NOT R3, R3		; Undo the last subtraction
+	ADD R3, R3, #1
+	ADD R1, R1, R3
+	ADD R4, R4, R0		; Skip any leading zeroes
+	BRz PD_SKIP
+	LD R3, PD_ZERO
+	ADD R0, R0, R3
+	OUT
+PD_SKIP
+	ADD R2, R2, #1
+	BRnzp PD_NEXT_POWER
+PD_UNITS
+	LD R3, PD_ZERO		; The units are always printed
+	ADD R0, R1, R3
+	OUT
+	LD R1, PD_R1		; Restore the registers
+	LD R2, PD_R2
+	LD R3, PD_R3
+	LD R4, PD_R4
+	LD R7, PD_R7
+	RET
+
+PD_POWERS	.FILL #10000
+		.FILL #1000
+		.FILL #100
+		.FILL #10
+		.FILL #0
+PD_ZERO		.FILL x30
+PD_R1		.BLKW 1
+PD_R2		.BLKW 1
+PD_R3		.BLKW 1
+PD_R4		.BLKW 1
+PD_R7		.BLKW 1
+
+.END
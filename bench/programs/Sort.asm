@@ -0,0 +1,71 @@
+;
+; Bubble sorts the characters of a sentence, and prints the sorted result. The
+; sort is repeated PASSES times on a fresh copy of the sentence, so that the
+; program runs long enough to be timed.
+;
+; Expected output:
+;                 AAABBCCDDDEEEEEFFGGHHHIIIIJJKKLLMMNNNOOOOOOOPPQQRRRSSTTTUUUUVVWWXXYYZZ
+;
+
+; R0 -- Character being copied
+; R1 -- Pointer into the text / the buffer
+; R2 -- The current character
+; R3 -- The next character
+; R4 -- Difference between the two
+; R5 -- Set when a swap happened during a pass over the buffer
+; R6 -- Remaining passes
+
+.ORIG x3000
+
+	LD R6, PASSES		; Load how many times to sort the text
+
+; Copy the unsorted text into the buffer
+SORT_AGAIN
+	LEA R1, TEXT
+	LEA R2, BUFFER
+COPY
+	LDR R0, R1, #0		; Copy one character
+	STR R0, R2, #0
+	ADD R0, R0, #0		; Stop after the terminator
+	BRz SORT
+	ADD R1, R1, #1
+	ADD R2, R2, #1
+	BRnzp COPY
+
+; Bubble the largest characters to the end until nothing moves
+SORT
+	AND R5, R5, #0		; Nothing has been swapped yet
+	LEA R1, BUFFER
+COMPARE
+	LDR R2, R1, #0		; Load the current character
+	LDR R3, R1, #1		; Load the next character
+	BRz PASS_DONE		; Reached the end of the string
+	NOT R4, R3		; R4 = current - next
+	ADD R4, R4, #1
+	ADD R4, R2, R4
+	BRnz NO_SWAP		; Already in order
+	STR R3, R1, #0		; Swap the two characters
+	STR R2, R1, #1
+	ADD R5, R5, #1		; Remember that we swapped
+NO_SWAP
+	ADD R1, R1, #1
+	BRnzp COMPARE
+PASS_DONE
+	ADD R5, R5, #0		; Sort again if anything moved
+	BRp SORT
+
+	ADD R6, R6, #-1		; Start again with a fresh copy
+	BRp SORT_AGAIN
+
+	LEA R0, BUFFER		; Print the sorted text
+	PUTS
+	LD R0, NEWLINE
+	OUT
+	HALT
+
+PASSES	.FILL #40
+NEWLINE	.FILL x0A
+TEXT	.STRINGZ "THE QUICK BROWN FOX JUMPS OVER THE LAZY DOG AND PACK MY BOX WITH FIVE DOZEN LIQUOR JUGS"
+BUFFER	.BLKW #100
+
+.END
@@ -0,0 +1,150 @@
+;
+; Reverses a sentence while swapping the case of every letter, then prints the
+; result followed by the number of words in the sentence. The work is repeated
+; PASSES times, so that the program runs long enough to be timed.
+;
+; Expected output:
+; .god yzal eht revo spmuj xof nworb kciuq ehT .SGNIRTS PU DEKCAB SKROW ti fi KCEHC
+; 16
+;
+
+; R0 -- The current character
+; R1 -- Pointer into the text
+; R2 -- Pointer into the buffer
+; R3 -- Temporary value
+; R4 -- Characters left to copy
+; R5 -- Number of words seen
+; R6 -- Remaining passes
+
+.ORIG x3000
+
+	LD R6, PASSES		; Load how many times to reverse the text
+
+; Find the end of the text, and how long it is
+STRING_AGAIN
+	LEA R1, TEXT
+	AND R4, R4, #0
+FIND_END
+	LDR R0, R1, #0
+	BRz FOUND_END
+	ADD R1, R1, #1
+	ADD R4, R4, #1
+	BRnzp FIND_END
+
+; Copy the text into the buffer backwards
+FOUND_END
+	LEA R2, BUFFER
+	AND R5, R5, #0		; There is always at least one word
+	ADD R5, R5, #1
+REVERSE
+	ADD R1, R1, #-1
+	LDR R0, R1, #0
+	LD R3, NEG_SPACE	; Each space starts another word
+	ADD R3, R0, R3
+	BRnp NOT_SPACE
+	ADD R5, R5, #1
+	BRnzp STORE
+NOT_SPACE
+	LD R3, LETTER_BIT	; Only letters have their case swapped
+	AND R3, R0, R3
+	BRz STORE
+	LD R3, CASE_BIT
+	AND R3, R0, R3
+	BRz TO_LOWER
+	LD R3, NEG_CASE_BIT	; Lower case to upper case
+	ADD R0, R0, R3
+	BRnzp STORE
+TO_LOWER
+	LD R3, CASE_BIT		; Upper case to lower case
+	ADD R0, R0, R3
+STORE
+	STR R0, R2, #0
+	ADD R2, R2, #1
+	ADD R4, R4, #-1
+	BRp REVERSE
+
+	AND R0, R0, #0		; Terminate the reversed string
+	STR R0, R2, #0
+
+	ADD R6, R6, #-1		; Reverse it again
+	BRp STRING_AGAIN
+
+	LEA R0, BUFFER		; Print the result, and the word count
+	PUTS
+	LD R0, NEWLINE
+	OUT
+	ADD R0, R5, #0
+	JSR PRINT_DECIMAL
+	LD R0, NEWLINE
+	OUT
+	HALT
+
+PASSES		.FILL #1000
+NEWLINE		.FILL x0A
+NEG_SPACE	.FILL #-32
+LETTER_BIT	.FILL x40
+CASE_BIT	.FILL x20
+NEG_CASE_BIT	.FILL #-32
+TEXT	.STRINGZ "check IF IT works backed up strings. tHE QUICK BROWN FOX JUMPS OVER THE LAZY DOG."
+BUFFER	.BLKW #100
+
+; --------------------------------------------------------------
+; Print the value in R0 (0 to 32767) in decimal, without any
+; leading zeroes. All registers except R0 are preserved.
+; --------------------------------------------------------------
+PRINT_DECIMAL
+	ST R1, PD_R1		; Save the registers we use
+	ST R2, PD_R2
+	ST R3, PD_R3
+	ST R4, PD_R4
+	ST R7, PD_R7
+	ADD R1, R0, #0		; R1 holds what is left to print
+	LEA R2, PD_POWERS	; R2 walks the table of powers of ten
+	AND R4, R4, #0		; R4 becomes positive once a digit is printed
+PD_NEXT_POWER
+	LDR R3, R2, #0		; Load the next power of ten
+	BRz PD_UNITS		; The table ends with a zero
+	NOT R3, R3		; Negate it
+	ADD R3, R3, #1
+	AND R0, R0, #0		; R0 counts how many times it fits
+PD_SUBTRACT
+	ADD R1, R1, R3
+	BRn PD_RESTORE
+	ADD R0, R0, #1
+	BRnzp PD_SUBTRACT
+PD_RESTORE
+	NOT R3, R3		; Undo the last subtraction
+	ADD R3, R3, #1
+	ADD R1, R1, R3
+	ADD R4, R4, R0		; Skip any leading zeroes
+	BRz PD_SKIP
+	LD R3, PD_ZERO
+	ADD R0, R0, R3
+	OUT
+PD_SKIP
+	ADD R2, R2, #1
+	BRnzp PD_NEXT_POWER
+PD_UNITS
+	LD R3, PD_ZERO		; The units are always printed
+	ADD R0, R1, R3
+	OUT
+	LD R1, PD_R1		; Restore the registers
+	LD R2, PD_R2
+	LD R3, PD_R3
+	LD R4, PD_R4
+	LD R7, PD_R7
+	RET
+
+PD_POWERS	.FILL #10000
+		.FILL #1000
+		.FILL #100
+		.FILL #10
+		.FILL #0
+PD_ZERO		.FILL x30
+PD_R1		.BLKW 1
+PD_R2		.BLKW 1
+PD_R3		.BLKW 1
+PD_R4		.BLKW 1
+PD_R7		.BLKW 1
+
+.END
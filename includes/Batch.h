@@ -0,0 +1,10 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stddef.h>
+
+#include "Structs.h"
+
+size_t assembleAll(struct program const *, char *const *, size_t, unsigned);
+
+#endif // BATCH_H
@@ -0,0 +1,19 @@
+#ifndef DISASSEMBLER_H
+#define DISASSEMBLER_H
+
+#include <stdio.h>
+
+#include "Structs.h"
+
+/*
+ * Disassembly of single words, and listings of whole stretches of memory.
+ * Operands that are relative to the PC are shown by label, or by address if
+ * nothing is labelled there.
+ */
+
+char *disassembleWord(struct program const *, uint16_t word, uint16_t address,
+                      char *buff, size_t size);
+void listMemory(struct program const *, uint16_t first, uint16_t last,
+                FILE *file);
+
+#endif // DISASSEMBLER_H
@@ -0,0 +1,68 @@
+#ifndef DISPLAY_H
+#define DISPLAY_H
+
+#include <curses.h>
+#include <stdbool.h>
+
+#include "Structs.h"
+#include "Enums.h"
+#include "Worker.h"
+#include "Search.h"
+
+/*
+ * What one row of the memory view has on it, so that it's only drawn again
+ * once something about it changes.
+ */
+
+struct shownRow {
+        bool drawn;
+        uint16_t address;
+        uint16_t value;
+        unsigned attributes;
+        unsigned generation;
+};
+
+/*
+ * Where the memory view is looking, and what it last showed.
+ */
+
+struct memoryView {
+        int selected;
+        uint16_t address;
+        uint16_t height;
+        uint16_t *output;
+        // The address the view was last generated at, or -1 if it has to
+        // start again from the PC.
+        int populated;
+        // What each of the rows has on it right now.
+        struct shownRow *shown;
+        // The last thing searched for, for finding the next one.
+        struct search search;
+        bool searching;
+};
+
+/*
+ * What the status pane shows, so that only the fields that change are drawn
+ * again. The fields that changed last time are highlighted.
+ */
+
+struct stateView {
+        bool drawn;
+        uint16_t registers[8];
+        uint16_t PC;
+        uint16_t IR;
+        unsigned char CC;
+        unsigned highlighted;
+};
+
+extern void printState(struct snapshot const *, WINDOW *, struct stateView *);
+
+void update(WINDOW *, struct program *, struct memoryView *);
+void generateContext(WINDOW *, struct program *, struct memoryView *, int,
+                     uint16_t);
+void liveContext(WINDOW *, struct program *, struct memoryView *,
+                 struct snapshot const *);
+void moveContext(WINDOW *, struct program *, struct memoryView *,
+                 enum DIRECTION);
+
+#endif // DISPLAY_H
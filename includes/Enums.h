@@ -31,4 +31,47 @@ enum DIRECTION {
 	DOWN        = 0x2,
 };
 
+/*
+ * Why a call to run() stopped.
+ */
+
+enum RUN_RESULT {
+	RUN_HALTED  = 0x0,
+	RUN_BUDGET  = 0x1,
+	RUN_TIMEOUT = 0x2,
+	RUN_HUNG    = 0x3,
+};
+
+/*
+ * What the interface can ask the simulator's thread to do (see Worker.c).
+ */
+
+enum COMMAND {
+	COMMAND_STEP              = 0x0,
+	COMMAND_RUN               = 0x1,
+	COMMAND_PAUSE             = 0x2,
+	COMMAND_RESET             = 0x3,
+	COMMAND_TOGGLE_BREAKPOINT = 0x4,
+	COMMAND_WRITE             = 0x5,
+	COMMAND_SET_PC            = 0x6,
+	COMMAND_INPUT             = 0x7,
+	// Run until a call (if there is one at the PC) has returned.
+	COMMAND_STEP_OVER         = 0x8,
+	// Run until the subroutine the machine is in returns.
+	COMMAND_STEP_OUT          = 0x9,
+	COMMAND_RUN_TO            = 0xa,
+	COMMAND_RUN_FOR           = 0xb,
+};
+
+/*
+ * What the simulator's thread was doing when it last said.
+ */
+
+enum WORKER_STATE {
+	WORKER_IDLE    = 0x0,
+	WORKER_RUNNING = 0x1,
+	// Waiting for a key, in the middle of an instruction.
+	WORKER_READING = 0x2,
+};
+
 #endif // ENUMS_H
@@ -12,6 +12,13 @@
 // Flags
 #define ASSEMBLE      0x000000000001
 #define ASSEMBLE_ONLY 0x000000000002
+#define HEADLESS      0x000000000004
+#define DISASSEMBLE   0x000000000008
+
+// Exit statuses when running without the interface.
+#define EXIT_BUDGET  3
+#define EXIT_TIMEOUT 4
+#define EXIT_HUNG    5
 
 __attribute__((noreturn)) void read_error(void);
 
@@ -24,6 +24,10 @@ const int RUN           = 'r';
 const int RESTART       = 'R';
 const int CONTINUE      = 'c';
 const int CONTINUE_RUN  = 'C';
+const int TURBO         = 't';
+const int STEP_OVER     = 'o';
+const int STEP_OUT      = 'O';
+const int RUN_FOR       = 'N';
 
 // Keyboard controls for the Main View
 const int LOGDUMP       = 'd';
@@ -36,6 +40,10 @@ const int JUMP          = 'j';
 const int EDITFILE      = 'e';
 const int SETPC         = 'S';
 const int BREAKPOINTSET = 'B';
+const int RUN_TO        = 'g';
+const int FIND          = '/';
+const int FIND_NEXT     = 'n';
+const int FIND_PREVIOUS = 'N';
 
 
 #endif // KEYBOARD_H
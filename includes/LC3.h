@@ -1,11 +1,14 @@
 #ifndef LC3_H
 #define LC3_H
 
-#include <curses.h>
-
 #include "Structs.h"
-
-extern void executeNext(struct LC3 *, WINDOW *);
-extern void printState(struct LC3 *, WINDOW *);
+#include "Enums.h"
+
+extern void step(struct LC3 *, struct console const *);
+extern enum RUN_RESULT run(struct LC3 *, struct console const *,
+                           struct limits const *);
+extern uint16_t readMemory(struct LC3 const *, uint16_t);
+extern void writeMemory(struct LC3 *, uint16_t, uint16_t);
+extern void markDirty(struct LC3 *, uint16_t);
 
 #endif // LC3_H
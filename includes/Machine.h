@@ -3,8 +3,7 @@
 
 #include "Structs.h"
 
-extern int memPopulated;
-
 extern void startMachine(struct program *);
+extern int runUnattended(struct program *);
 
 #endif // MACHINE_H
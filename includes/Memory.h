@@ -1,21 +1,23 @@
 #ifndef MEMORY_H
 #define MEMORY_H
 
-#include <curses.h>
+#include <stdio.h>
 
 #include "Structs.h"
 #include "Enums.h"
 
-extern int selected;
-extern uint16_t outputHeight;
-extern uint16_t *memoryOutput;
-extern uint16_t selectedAddress;
-
-void update(WINDOW *, struct program *);
+void useOS(char const *objectFile);
+char const *customOS(void);
 int populateMemory(struct program *);
-void printMemory(WINDOW *, struct program *, uint16_t *, const char);
+void snapshotMachine(struct program *);
+void resetMachine(struct program *);
+int listProgram(struct program *, long, long, FILE *);
+
+// The most disassemble() writes, including the terminating NUL.
+#define DISASSEMBLY_LENGTH 100
 
-void generateContext(WINDOW *, struct program *, int, uint16_t);
-void moveContext(WINDOW *, struct program *, enum DIRECTION);
+char *disassemble(struct program *, uint16_t, char *);
+char const *memoryRow(struct program *, uint16_t, uint16_t);
+void freeRows(struct program *);
 
 #endif // MEMORY_H
@@ -0,0 +1,24 @@
+#ifndef OS_H
+#define OS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * The Operating System that's built in, which is LC3_OS.asm put through our
+ * own assembler as we're built. Its words are laid out as they are in an object
+ * file, with the origin first.
+ */
+
+struct OSSymbol {
+	char const *name;
+	uint16_t address;
+};
+
+extern uint16_t const builtinOS[];
+extern size_t const builtinOSLength;
+
+extern struct OSSymbol const builtinOSSymbols[];
+extern size_t const builtinOSSymbolCount;
+
+#endif // OS_H
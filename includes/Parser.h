@@ -6,13 +6,12 @@
 
 #include "Structs.h"
 
-extern bool OSInstalled;
-extern struct symbolTable tableHead;
-
-void populateOSSymbols(void);
+void populateOSSymbols(struct program *prog);
 void populateSymbolsFromFile(struct program *prog);
-struct symbol *findSymbolByAddress(uint16_t address);
+struct symbol *findSymbol(struct program const *prog, char const *name);
+struct symbol *findSymbolByAddress(struct program const *prog,
+                                   uint16_t address);
 bool parse(struct program *prog);
-void freeTable(struct symbolTable *table);
+void freeTable(struct program *prog);
 
 #endif // PARSER_H
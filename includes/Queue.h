@@ -0,0 +1,31 @@
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * A fixed size queue between exactly two threads: one that only pushes, and
+ * one that only pops. Neither ever waits on the other; a push to a full queue,
+ * or a pop from an empty one, just fails.
+ */
+
+struct queue {
+        unsigned char *items;
+        size_t size;
+        // Always a power of two.
+        size_t capacity;
+        // Each end is only written by its own thread, so they're kept apart
+        // to stop them sharing a cache line.
+        _Alignas(64) atomic_size_t head;
+        _Alignas(64) atomic_size_t tail;
+};
+
+void initQueue(struct queue *, size_t size, size_t capacity);
+void freeQueue(struct queue *);
+bool pushQueue(struct queue *, void const *item);
+bool popQueue(struct queue *, void *item);
+bool queueFull(struct queue *);
+
+#endif // QUEUE_H
@@ -0,0 +1,18 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stddef.h>
+
+/*
+ * Bulk scanning of assembly source, 16 bytes at a time where SSE2 is
+ * available. Each function looks at [at, end), and those that search return
+ * where they stopped, or end if they ran out of source.
+ */
+
+char const *skipBlanks(char const *at, char const *end);
+char const *findSpace(char const *at, char const *end);
+char const *findLabelEnd(char const *at, char const *end);
+char const *findNewline(char const *at, char const *end);
+size_t countLines(char const *at, char const *end);
+
+#endif // SCAN_H
@@ -0,0 +1,39 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Structs.h"
+
+// The most words a search can match in a row.
+#define SEARCH_LENGTH 64
+// The most ways there are of storing what's searched for.
+#define SEARCH_PATTERNS 3
+
+/*
+ * A run of words to find, where each word only has to match in the bits of
+ * its mask.
+ */
+
+struct pattern {
+        size_t length;
+        uint16_t masks[SEARCH_LENGTH];
+        uint16_t values[SEARCH_LENGTH];
+};
+
+/*
+ * What to look for in memory. A string can be stored more than one way, so it
+ * is searched for as each of them at once.
+ */
+
+struct search {
+        size_t count;
+        struct pattern patterns[SEARCH_PATTERNS];
+};
+
+bool parseSearch(char const *, struct search *);
+long searchMemory(struct LC3 const *, struct search const *, uint16_t, bool);
+
+#endif // SEARCH_H
@@ -1,6 +1,7 @@
 #ifndef STRUCTS_H
 #define STRUCTS_H
 
+#include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -10,6 +11,26 @@ struct memorySlot {
 	bool isBreakpoint;
 };
 
+/*
+ * The state of the machine the last time it branched back to a loop head,
+ * used to notice when a loop can never exit.
+ */
+
+struct loopHead {
+	bool seen;
+	unsigned char CC;
+	uint16_t PC;
+	uint16_t registers[8];
+	unsigned long changes;
+};
+
+#define LOOP_HEADS 16
+
+// Memory is split into pages of 256 words, to keep track of which parts of it
+// a program has changed.
+#define PAGE_BITS 8
+#define PAGES     (0x10000 >> PAGE_BITS)
+
 struct LC3 {
 	unsigned char CC;
 	uint16_t PC;
@@ -17,9 +38,98 @@ struct LC3 {
 	uint16_t registers[8];
 	bool isHalted;
 	bool isPaused;
-	struct memorySlot memory[0xffff];
+	bool detectHangs;
+	bool isHung;
+	// Counts every change to memory, and every character read, so that we
+	// can tell whether anything happened between two visits to a loop head.
+	unsigned long changes;
+	struct loopHead loopHeads[LOOP_HEADS];
+	// A bit for every page of memory that has changed since it was loaded.
+	uint64_t dirtyPages[PAGES / 64];
+	struct memorySlot memory[0x10000];
+};
+
+/*
+ * Limits on a run of the simulator. Zero means no limit.
+ */
+
+struct limits {
+	unsigned long long instructions;
+	double seconds;
+	bool detectHangs;
+};
+
+/*
+ * Where a simulator reads keyboard input from, and writes display output to.
+ */
+
+struct console {
+	int (*read)(void *data);
+	void (*write)(void *data, char c);
+	void *data;
+};
+
+struct symbol {
+	char *name;
+	uint32_t hash;
+	uint16_t address;
+	bool fromOS;
+	int line;
+	// The next symbol added at the same address, if any.
+	struct symbol *sameAddress;
+};
+
+struct symbolBlock;
+struct symbolCache;
+
+/*
+ * The symbols are kept three times over: in the order they were added, which is
+ * the order they're written out in, in an open addressed hash table to find
+ * them by name, and by address. The symbols themselves, and their names, are
+ * packed into blocks that are freed all at once.
+ */
+
+struct symbolTable {
+	struct symbol **symbols;
+	size_t count, capacity;
+
+	// Always a power of two in size, and never more than half full.
+	struct symbol **slots;
+	size_t slotCount;
+
+	// The first symbol added at each of the 0x10000 addresses.
+	struct symbol **byAddress;
+
+	struct symbolBlock *blocks;
+	// Symbol caches that some of the symbols' names are still in.
+	struct symbolCache *caches;
+
+	// Goes up every time a symbol is added, so that anything worked out
+	// from the symbols can tell when it's out of date.
+	unsigned generation;
+};
+
+/*
+ * The files the assembler can write.
+ */
+
+enum format {
+	FORMAT_OBJ = 0x1,
+	FORMAT_SYM = 0x2,
+	FORMAT_HEX = 0x4,
+	FORMAT_BIN = 0x8,
+	// The symbols again, in a form that can be loaded without parsing.
+	FORMAT_SYMC = 0x10,
 };
 
+struct memoryRows;
+
+/*
+ * Everything needed to assemble, load, and run a single program. Nothing is
+ * shared between two of these, so separate programs can be used from separate
+ * threads.
+ */
+
 struct program {
 	char *name;
 	char *logfile;
@@ -29,22 +139,34 @@ struct program {
 	char *hexoutfile;
 	char *binoutfile;
         bool warn;
+	// The formats the assembler writes. None at all means every one.
+	unsigned formats;
 
 	int verbosity;
+	// Where the assembler reports its progress and any problems. When this
+	// is NULL, progress goes to stdout and problems to stderr.
+	FILE *messages;
 
-	struct LC3 simulator;
-};
+	struct limits limits;
+	// How many times a second the interface redraws a running machine. None
+	// at all means its own default. In turbo, nothing is drawn until the
+	// machine stops.
+	unsigned frameRate;
+	bool turbo;
 
-struct symbol {
-	char *name;
-	uint16_t address;
-	bool fromOS;
-	int line;
-};
+	// The symbols of both the Operating System and the program, in the
+	// order they were added.
+	struct symbolTable symbols;
+	bool OSInstalled;
+	bool symbolsInstalled;
 
-struct symbolTable {
-	struct symbol *sym;
-	struct symbolTable *next;
+	struct LC3 simulator;
+	// The simulator as it was just after the program was loaded, to reset
+	// it to.
+	struct LC3 *pristine;
+
+	// The memory view's rows, as they were last shown (see Memory.c).
+	struct memoryRows *rows;
 };
 
 #endif // STRUCTS_H
@@ -0,0 +1,110 @@
+#ifndef WORKER_H
+#define WORKER_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "Structs.h"
+#include "Enums.h"
+#include "Queue.h"
+
+// How many words of memory, from the PC on, go with each snapshot.
+#define LIVE_WORDS 256
+
+struct command {
+        enum COMMAND type;
+        uint16_t address;
+        // The word to write, the key pressed, or how many instructions to
+        // run.
+        uint32_t value;
+};
+
+/*
+ * Where the machine stops of its own accord, for the commands that only run
+ * it so far. Calls and returns are counted on the way, so that a subroutine
+ * that calls itself doesn't stop it at the wrong return.
+ */
+
+struct target {
+        bool set;
+        // Stop at this address...
+        bool hasAddress;
+        uint16_t address;
+        // ...but only once every call made since has returned.
+        bool sameFrame;
+        // Stop once more has returned than was called.
+        bool onReturn;
+        long depth;
+        // Stop after this many more instructions, unless it's 0.
+        unsigned long remaining;
+};
+
+/*
+ * The machine as the simulator's thread last saw it, and how far it had got
+ * through the commands it was sent.
+ */
+
+struct snapshot {
+        uint16_t registers[8];
+        uint16_t PC;
+        uint16_t IR;
+        unsigned char CC;
+        bool isHalted;
+        bool isPaused;
+        enum WORKER_STATE state;
+        unsigned long processed;
+        // How many times a breakpoint has stopped the machine.
+        unsigned breakpointsHit;
+        // Memory from first on, so that it can be shown while the machine
+        // runs, with a bit for each word that has a breakpoint on it.
+        uint16_t first;
+        uint16_t words[LIVE_WORDS];
+        uint64_t breakpoints[LIVE_WORDS / 64];
+};
+
+/*
+ * A program being run on a thread of its own. Commands go to it, and the
+ * characters it prints and snapshots of the machine come back, over queues
+ * that are never locked. The lock is only there for the thread to sleep on
+ * when it has nothing to do.
+ */
+
+struct worker {
+        struct program *program;
+        pthread_t thread;
+
+        struct queue commands;
+        struct queue output;
+        struct queue snapshots;
+
+        pthread_mutex_t lock;
+        pthread_cond_t wake;
+        bool woken;
+        atomic_bool stopping;
+
+        // Only ever touched by the simulator's thread.
+        unsigned long processed;
+        unsigned breakpointsHit;
+        bool reading;
+        bool changed;
+        bool deferred;
+        struct command later;
+        struct target target;
+
+        // Only ever touched by the interface.
+        unsigned long sent;
+        struct snapshot latest;
+        // How many of the breakpoint hits have been pointed out.
+        unsigned breakpointsShown;
+};
+
+void startWorker(struct worker *, struct program *);
+void stopWorker(struct worker *);
+void sendCommand(struct worker *, enum COMMAND, uint16_t, uint32_t);
+bool readOutput(struct worker *, char *);
+bool takeSnapshot(struct worker *);
+bool workerSettled(struct worker const *);
+
+#endif // WORKER_H
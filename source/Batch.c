@@ -0,0 +1,191 @@
+#ifdef __linux__
+#define _XOPEN_SOURCE 700
+#endif
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "Batch.h"
+#include "Error.h"
+#include "Parser.h"
+
+/*
+ * One file to assemble, and what came of it.
+ */
+
+struct job {
+        char const *file;
+        char *messages;
+        size_t length;
+        bool assembled;
+        bool done;
+};
+
+struct batch {
+        struct program const *settings;
+        struct job *jobs;
+        size_t count;
+        size_t next;
+        pthread_mutex_t lock;
+        pthread_cond_t finished;
+};
+
+static void assemble(struct program *program, struct job *job)
+{
+        FILE *messages = open_memstream(&job->messages, &job->length);
+        if (NULL == messages) {
+                perror("LC3-Simulator");
+                exit(EXIT_FAILURE);
+        }
+
+        // parse() gives up on the whole process if it can't open the file,
+        // which is a bit much when it's one of many.
+        FILE *file = fopen(job->file, "r");
+        if (NULL == file) {
+                fprintf(messages, "ERROR: %s: %s.\n", job->file,
+                        strerror(errno));
+                fclose(messages);
+                job->assembled = false;
+                return;
+        }
+
+        fclose(file);
+
+        program->assemblyfile = strdup(job->file);
+        if (NULL == program->assemblyfile) {
+                perror("LC3-Simulator");
+                exit(EXIT_FAILURE);
+        }
+
+        program->messages = messages;
+        job->assembled = parse(program);
+
+        fclose(messages);
+        tidyUp(program);
+}
+
+/*
+ * Keep taking the next file that nobody has started on until there are none
+ * left. Each thread has a program of its own that it reuses for every file.
+ */
+
+static void *worker(void *data)
+{
+        struct batch *batch = data;
+        struct program *program = malloc(sizeof(struct program));
+        size_t index;
+
+        if (NULL == program) {
+                perror("LC3-Simulator");
+                exit(EXIT_FAILURE);
+        }
+
+        while (1) {
+                pthread_mutex_lock(&batch->lock);
+                index = batch->next++;
+                pthread_mutex_unlock(&batch->lock);
+
+                if (index >= batch->count) {
+                        break;
+                }
+
+                *program = (struct program) {
+                        .warn      = batch->settings->warn,
+                        .verbosity = batch->settings->verbosity,
+                        .formats   = batch->settings->formats,
+                };
+
+                assemble(program, &batch->jobs[index]);
+
+                pthread_mutex_lock(&batch->lock);
+                batch->jobs[index].done = true;
+                pthread_cond_broadcast(&batch->finished);
+                pthread_mutex_unlock(&batch->lock);
+        }
+
+        free(program);
+
+        return NULL;
+}
+
+/*
+ * Assemble each of the given files, using up to the given number of threads
+ * (or one per processor, if that's 0). What the assembler has to say about
+ * each file is printed to stdout in the same order the files were given, no
+ * matter which finishes first.
+ *
+ * Returns: The number of files that failed to assemble.
+ */
+
+size_t assembleAll(struct program const *settings, char *const *files,
+                   size_t count, unsigned threads)
+{
+        size_t failed = 0;
+        struct batch batch = {
+                .settings = settings,
+                .count    = count,
+                .next     = 0,
+        };
+
+        if (!threads) {
+                long processors = sysconf(_SC_NPROCESSORS_ONLN);
+                threads = processors > 0 ? (unsigned) processors : 1;
+        }
+
+        if (threads > count) {
+                threads = (unsigned) count;
+        }
+
+        batch.jobs = calloc(count, sizeof(struct job));
+        pthread_t *workers = calloc(threads, sizeof(pthread_t));
+        if (NULL == batch.jobs || NULL == workers) {
+                perror("LC3-Simulator");
+                exit(EXIT_FAILURE);
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+                batch.jobs[i].file = files[i];
+        }
+
+        pthread_mutex_init(&batch.lock, NULL);
+        pthread_cond_init(&batch.finished, NULL);
+
+        for (unsigned i = 0; i < threads; ++i) {
+                if (pthread_create(&workers[i], NULL, worker, &batch)) {
+                        perror("LC3-Simulator");
+                        exit(EXIT_FAILURE);
+                }
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+                struct job *job = &batch.jobs[i];
+
+                pthread_mutex_lock(&batch.lock);
+                while (!job->done) {
+                        pthread_cond_wait(&batch.finished, &batch.lock);
+                }
+                pthread_mutex_unlock(&batch.lock);
+
+                printf("==> %s <==\n", job->file);
+                fwrite(job->messages, 1, job->length, stdout);
+                free(job->messages);
+
+                failed += !job->assembled;
+        }
+
+        for (unsigned i = 0; i < threads; ++i) {
+                pthread_join(workers[i], NULL);
+        }
+
+        pthread_cond_destroy(&batch.finished);
+        pthread_mutex_destroy(&batch.lock);
+        free(workers);
+        free(batch.jobs);
+
+        return failed;
+}
@@ -0,0 +1,443 @@
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Disassembler.h"
+#include "Enums.h"
+#include "Parser.h"
+
+/*
+ * Every word is decoded ahead of time into what it says and which operands
+ * it has, so that disassembling is a lookup in one table and copying out a
+ * few strings, rather than picking the word apart every time.
+ */
+
+enum mnemonic {
+        MNEMONIC_NOP,
+        MNEMONIC_BRP,
+        MNEMONIC_BRZ,
+        MNEMONIC_BRZP,
+        MNEMONIC_BRN,
+        MNEMONIC_BRNP,
+        MNEMONIC_BRNZ,
+        MNEMONIC_BRNZP,
+        MNEMONIC_ADD,
+        MNEMONIC_AND,
+        MNEMONIC_NOT,
+        MNEMONIC_LD,
+        MNEMONIC_LDI,
+        MNEMONIC_LDR,
+        MNEMONIC_LEA,
+        MNEMONIC_ST,
+        MNEMONIC_STI,
+        MNEMONIC_STR,
+        MNEMONIC_JMP,
+        MNEMONIC_RET,
+        MNEMONIC_JSR,
+        MNEMONIC_JSRR,
+        MNEMONIC_RTI,
+        MNEMONIC_TRAP,
+        MNEMONIC_GETC,
+        MNEMONIC_OUT,
+        MNEMONIC_PUTS,
+        MNEMONIC_IN,
+        MNEMONIC_PUTSP,
+        MNEMONIC_HALT,
+        MNEMONIC_FILL,
+};
+
+// The branches are in order of their condition codes, so that BR's nzp bits
+// pick out its mnemonic. Each is padded out so it can be copied in one go.
+static struct {
+        char text[8];
+        size_t length;
+} const mnemonics[] = {
+#define MNEMONIC(text) { text, sizeof(text) - 1 }
+        MNEMONIC("NOP"),  MNEMONIC("BRp"),  MNEMONIC("BRz"),
+        MNEMONIC("BRzp"), MNEMONIC("BRn"),  MNEMONIC("BRnp"),
+        MNEMONIC("BRnz"), MNEMONIC("BRnzp"),
+        MNEMONIC("ADD"),  MNEMONIC("AND"),  MNEMONIC("NOT"),
+        MNEMONIC("LD"),   MNEMONIC("LDI"),  MNEMONIC("LDR"),
+        MNEMONIC("LEA"),  MNEMONIC("ST"),   MNEMONIC("STI"),
+        MNEMONIC("STR"),  MNEMONIC("JMP"),  MNEMONIC("RET"),
+        MNEMONIC("JSR"),  MNEMONIC("JSRR"), MNEMONIC("RTI"),
+        MNEMONIC("TRAP"), MNEMONIC("GETC"), MNEMONIC("OUT"),
+        MNEMONIC("PUTS"), MNEMONIC("IN"),   MNEMONIC("PUTSP"),
+        MNEMONIC("HALT"), MNEMONIC(".FILL"),
+#undef MNEMONIC
+};
+
+enum operands {
+        OPERANDS_NONE,
+        // JMP R1
+        OPERANDS_R,
+        // NOT R0, R1
+        OPERANDS_RR,
+        // ADD R0, R1, R2
+        OPERANDS_RRR,
+        // ADD R0, R1, #-1
+        OPERANDS_RRI,
+        // LD R0, LABEL
+        OPERANDS_RL,
+        // BRnz LABEL
+        OPERANDS_L,
+        // TRAP x26 or .FILL xD000
+        OPERANDS_X,
+};
+
+/*
+ * A decoded word. The third register of OPERANDS_RRR is kept in value, as is
+ * any immediate, PC offset, or trap vector.
+ */
+
+struct decoding {
+        uint8_t mnemonic;
+        uint8_t operands;
+        uint8_t first;
+        uint8_t second;
+        int16_t value;
+};
+
+static struct decoding decodings[0x10000];
+static pthread_once_t decodingsOnce = PTHREAD_ONCE_INIT;
+
+static char const hexDigits[] = "0123456789ABCDEF";
+
+static int16_t signExtend(uint16_t word, int bits)
+{
+        return (int16_t) ((int16_t) (word << (16 - bits)) >> (16 - bits));
+}
+
+static struct decoding decode(uint16_t word)
+{
+        struct decoding decoding = {
+                .operands = OPERANDS_NONE,
+                .first    = (uint8_t) (word >> 9 & 0x7),
+                .second   = (uint8_t) (word >> 6 & 0x7),
+        };
+
+        switch (word & 0xF000) {
+        case BR:
+                // Without any condition codes, a branch is never taken.
+                decoding.mnemonic = (uint8_t) (MNEMONIC_NOP + (word >> 9 & 0x7));
+                if (MNEMONIC_NOP != decoding.mnemonic) {
+                        decoding.operands = OPERANDS_L;
+                        decoding.value = signExtend(word, 9);
+                }
+                break;
+        case ADD:
+        case AND:
+                decoding.mnemonic = ADD == (word & 0xF000) ?
+                                    MNEMONIC_ADD : MNEMONIC_AND;
+                if (word & 0x20) {
+                        decoding.operands = OPERANDS_RRI;
+                        decoding.value = signExtend(word, 5);
+                } else {
+                        decoding.operands = OPERANDS_RRR;
+                        decoding.value = (int16_t) (word & 0x7);
+                }
+                break;
+        case NOT:
+                decoding.mnemonic = MNEMONIC_NOT;
+                decoding.operands = OPERANDS_RR;
+                break;
+        case LD:
+        case LDI:
+        case LEA:
+        case ST:
+        case STI:
+                decoding.mnemonic = LD  == (word & 0xF000) ? MNEMONIC_LD  :
+                                    LDI == (word & 0xF000) ? MNEMONIC_LDI :
+                                    LEA == (word & 0xF000) ? MNEMONIC_LEA :
+                                    ST  == (word & 0xF000) ? MNEMONIC_ST  :
+                                                             MNEMONIC_STI;
+                decoding.operands = OPERANDS_RL;
+                decoding.value = signExtend(word, 9);
+                break;
+        case LDR:
+        case STR:
+                decoding.mnemonic = LDR == (word & 0xF000) ?
+                                    MNEMONIC_LDR : MNEMONIC_STR;
+                decoding.operands = OPERANDS_RRI;
+                decoding.value = signExtend(word, 6);
+                break;
+        case JMP:
+                if (7 == decoding.second) {
+                        decoding.mnemonic = MNEMONIC_RET;
+                } else {
+                        decoding.mnemonic = MNEMONIC_JMP;
+                        decoding.operands = OPERANDS_R;
+                        decoding.first = decoding.second;
+                }
+                break;
+        case JSR:
+                if (word & 0x0800) {
+                        decoding.mnemonic = MNEMONIC_JSR;
+                        decoding.operands = OPERANDS_L;
+                        decoding.value = signExtend(word, 11);
+                } else {
+                        decoding.mnemonic = MNEMONIC_JSRR;
+                        decoding.operands = OPERANDS_R;
+                        decoding.first = decoding.second;
+                }
+                break;
+        case RTI:
+                decoding.mnemonic = MNEMONIC_RTI;
+                break;
+        case TRAP:
+                switch (word & 0x00FF) {
+                case 0x20:
+                        decoding.mnemonic = MNEMONIC_GETC;
+                        break;
+                case 0x21:
+                        decoding.mnemonic = MNEMONIC_OUT;
+                        break;
+                case 0x22:
+                        decoding.mnemonic = MNEMONIC_PUTS;
+                        break;
+                case 0x23:
+                        decoding.mnemonic = MNEMONIC_IN;
+                        break;
+                case 0x24:
+                        decoding.mnemonic = MNEMONIC_PUTSP;
+                        break;
+                case 0x25:
+                        decoding.mnemonic = MNEMONIC_HALT;
+                        break;
+                default:
+                        decoding.mnemonic = MNEMONIC_TRAP;
+                        decoding.operands = OPERANDS_X;
+                        decoding.value = (int16_t) (word & 0x00FF);
+                        break;
+                }
+                break;
+        default:
+                // The reserved opcode isn't an instruction at all.
+                decoding.mnemonic = MNEMONIC_FILL;
+                decoding.operands = OPERANDS_X;
+                decoding.value = (int16_t) word;
+                break;
+        }
+
+        return decoding;
+}
+
+static void buildDecodings(void)
+{
+        for (uint32_t word = 0; word < 0x10000; word++) {
+                decodings[word] = decode((uint16_t) word);
+        }
+}
+
+/*
+ * The most render() writes, leaving aside names, which are cut short to fit
+ * whatever room is left.
+ */
+
+#define RENDER_LENGTH 32
+
+static char *putName(char *at, char const *end, char const *name)
+{
+        size_t length = strlen(name);
+
+        if (length > (size_t) (end - at)) {
+                length = (size_t) (end - at);
+        }
+
+        memcpy(at, name, length);
+        return at + length;
+}
+
+static char *putRegister(char *at, unsigned reg)
+{
+        at[0] = 'R';
+        at[1] = (char) ('0' + reg);
+        return at + 2;
+}
+
+static char *putSeparator(char *at)
+{
+        at[0] = ',';
+        at[1] = ' ';
+        return at + 2;
+}
+
+static char *putHex(char *at, uint16_t value, int digits)
+{
+        *at = 'x';
+        for (int i = 0; i < digits; i++) {
+                at[digits - i] = hexDigits[value >> (4 * i) & 0xF];
+        }
+
+        return at + digits + 1;
+}
+
+// Immediates are at most six bits, so two digits at most.
+static char *putImmediate(char *at, int value)
+{
+        *at++ = '#';
+        if (value < 0) {
+                *at++ = '-';
+                value = -value;
+        }
+        if (value >= 10) {
+                *at++ = (char) ('0' + value / 10);
+        }
+        *at++ = (char) ('0' + value % 10);
+
+        return at;
+}
+
+/*
+ * Where a PC relative operand goes, by name if it has one, and otherwise
+ * by address.
+ */
+
+static char *putTarget(char *at, char const *end,
+                       struct program const *program, uint16_t target)
+{
+        struct symbol const *symbol = findSymbolByAddress(program, target);
+
+        return NULL != symbol ? putName(at, end, symbol->name) :
+                                putHex(at, target, 4);
+}
+
+/*
+ * Disassemble a word at the given address, with at least RENDER_LENGTH
+ * characters to do it in before the end (where the NUL goes).
+ *
+ * Returns: Where the NUL went.
+ */
+
+__attribute__((always_inline))
+static inline char *render(struct program const *program, uint16_t word,
+                           uint16_t address, char *at, char const *end)
+{
+        struct decoding const *decoding = &decodings[word];
+        // PC relative operands are relative to the next instruction.
+        uint16_t const target = (uint16_t) (address + 1 + decoding->value);
+
+        memcpy(at, mnemonics[decoding->mnemonic].text,
+               sizeof(mnemonics[0].text));
+        at += mnemonics[decoding->mnemonic].length;
+
+        if (OPERANDS_NONE != decoding->operands) {
+                *at++ = ' ';
+        }
+
+        switch (decoding->operands) {
+        case OPERANDS_R:
+                at = putRegister(at, decoding->first);
+                break;
+        case OPERANDS_RR:
+                at = putRegister(at, decoding->first);
+                at = putSeparator(at);
+                at = putRegister(at, decoding->second);
+                break;
+        case OPERANDS_RRR:
+                at = putRegister(at, decoding->first);
+                at = putSeparator(at);
+                at = putRegister(at, decoding->second);
+                at = putSeparator(at);
+                at = putRegister(at, (unsigned) decoding->value);
+                break;
+        case OPERANDS_RRI:
+                at = putRegister(at, decoding->first);
+                at = putSeparator(at);
+                at = putRegister(at, decoding->second);
+                at = putSeparator(at);
+                at = putImmediate(at, decoding->value);
+                break;
+        case OPERANDS_RL:
+                at = putRegister(at, decoding->first);
+                at = putSeparator(at);
+                at = putTarget(at, end, program, target);
+                break;
+        case OPERANDS_L:
+                at = putTarget(at, end, program, target);
+                break;
+        case OPERANDS_X:
+                at = putHex(at, (uint16_t) decoding->value,
+                            MNEMONIC_TRAP == decoding->mnemonic ? 2 : 4);
+                break;
+        default:
+                break;
+        }
+
+        *at = '\0';
+
+        return at;
+}
+
+char *disassembleWord(struct program const *program, uint16_t word,
+                      uint16_t address, char *buff, size_t size)
+{
+        char small[RENDER_LENGTH + 1];
+
+        pthread_once(&decodingsOnce, buildDecodings);
+
+        if (size > RENDER_LENGTH) {
+                render(program, word, address, buff, buff + size - 1);
+        } else if (size) {
+                render(program, word, address, small, small + RENDER_LENGTH);
+                memcpy(buff, small, size - 1);
+                buff[size - 1] = '\0';
+        }
+
+        return buff;
+}
+
+/*
+ * Longest line the listing writes, and how much of it labels get.
+ */
+
+#define LISTING_LINE 256
+#define LABEL_WIDTH  25
+#define LABEL_LIMIT  100
+
+void listMemory(struct program const *program, uint16_t first, uint16_t last,
+                FILE *file)
+{
+        size_t const count = (size_t) (last - first) + 1;
+        char *listing = malloc(count * LISTING_LINE);
+        char *at = listing;
+
+        if (NULL == listing) {
+                perror("LC3-Simulator");
+                exit(EXIT_FAILURE);
+        }
+
+        pthread_once(&decodingsOnce, buildDecodings);
+
+        for (size_t i = 0; i < count; i++) {
+                uint16_t const address = (uint16_t) (first + i);
+                uint16_t const word = program->simulator.memory[address].value;
+                struct symbol const *symbol =
+                        findSymbolByAddress(program, address);
+                char *const end = at + LISTING_LINE - 1;
+                char *label;
+
+                at = putHex(at, address, 4);
+                *at++ = ' ';
+                *at++ = ' ';
+                at = putHex(at, word, 4);
+                *at++ = ' ';
+                *at++ = ' ';
+
+                label = at;
+                if (NULL != symbol) {
+                        at = putName(at, label + LABEL_LIMIT, symbol->name);
+                }
+                do {
+                        *at++ = ' ';
+                } while (at - label <= LABEL_WIDTH);
+
+                at = render(program, word, address, at, end);
+                *at++ = '\n';
+        }
+
+        fwrite(listing, 1, (size_t) (at - listing), file);
+        free(listing);
+}
@@ -0,0 +1,275 @@
+#include <string.h>
+
+#include "Display.h"
+#include "Memory.h"
+
+static unsigned int const SELECTED_ATTRIBUTES = A_REVERSE | A_BOLD;
+static unsigned int const BREAKPOINT_ATTRIBUTES = COLOR_PAIR(1) | A_REVERSE;
+
+static unsigned int const CHANGED_ATTRIBUTES = A_BOLD;
+
+// The fields of the status pane, as bits of stateView.highlighted.
+#define FIELD_PC (1u << 8)
+#define FIELD_IR (1u << 9)
+#define FIELD_CC (1u << 10)
+
+/*
+ * Draw one field of the status pane, highlighted if it just changed.
+ */
+
+static void printField(WINDOW *window, struct stateView const *shown,
+                       unsigned field, int y, int x, char const *name,
+                       uint16_t value)
+{
+        wattrset(window, (int) (shown->highlighted & field ?
+                                CHANGED_ATTRIBUTES : A_NORMAL));
+        // Padded, so that nothing is left behind of a longer value.
+        mvwprintw(window, y, x, "%s 0x%04X %-6hd", name, value, value);
+        wattrset(window, A_NORMAL);
+}
+
+/*
+ * Print the state of the simulator, as of the given snapshot, to the window
+ * provided. Only the fields that differ from what's shown are drawn again, and
+ * the window is left for the next doupdate() to send to the terminal.
+ */
+
+void printState(struct snapshot const *simulator, WINDOW *window,
+                struct stateView *shown)
+{
+        char name[3] = "R0";
+        unsigned changed = 0, redraw;
+
+        for (int i = 0; i < 8; ++i) {
+                if (shown->registers[i] != simulator->registers[i]) {
+                        changed |= 1u << i;
+                }
+        }
+        if (shown->PC != simulator->PC) {
+                changed |= FIELD_PC;
+        }
+        if (shown->IR != simulator->IR) {
+                changed |= FIELD_IR;
+        }
+        if (shown->CC != simulator->CC) {
+                changed |= FIELD_CC;
+        }
+
+        if (!shown->drawn) {
+                // Nothing has been drawn yet, so there's nothing to compare
+                // against.
+                wclear(window);
+                box(window, 0, 0);
+                changed = 0;
+                redraw = ~0u;
+        } else if (!changed) {
+                return;
+        } else {
+                // Whatever was highlighted before goes back to normal.
+                redraw = changed | shown->highlighted;
+        }
+
+        shown->drawn = true;
+        shown->highlighted = changed;
+        memcpy(shown->registers, simulator->registers,
+               sizeof(shown->registers));
+        shown->PC = simulator->PC;
+        shown->IR = simulator->IR;
+        shown->CC = simulator->CC;
+
+        // The first four registers go down the left, and the last four next
+        // to them.
+        for (int i = 0; i < 8; ++i) {
+                if (redraw & 1u << i) {
+                        name[1] = (char) ('0' + i);
+                        printField(window, shown, 1u << i, i % 4 + 1,
+                                   i < 4 ? 3 : 20, name,
+                                   simulator->registers[i]);
+                }
+        }
+
+        if (redraw & FIELD_PC) {
+                printField(window, shown, FIELD_PC, 1, 37, "PC",
+                           simulator->PC);
+        }
+        if (redraw & FIELD_IR) {
+                printField(window, shown, FIELD_IR, 2, 37, "IR",
+                           simulator->IR);
+        }
+        if (redraw & FIELD_CC) {
+                wattrset(window, (int) (changed & FIELD_CC ?
+                                        CHANGED_ATTRIBUTES : A_NORMAL));
+                mvwprintw(window, 3, 37, "CC %c", simulator->CC);
+                wattrset(window, A_NORMAL);
+        }
+
+        wnoutrefresh(window);
+}
+
+/*
+ * Draw one row of the memory view, unless it already shows exactly this. Like
+ * the rest of the view, it isn't sent to the terminal until the view is
+ * flushed.
+ */
+
+static void drawRow(WINDOW *window, struct program *program,
+                    struct memoryView *view, int row, uint16_t address,
+                    uint16_t value, unsigned attributes)
+{
+        struct shownRow *shown = &view->shown[row];
+        struct shownRow const now = {
+                .drawn      = true,
+                .address    = address,
+                .value      = value,
+                .attributes = attributes,
+                .generation = program->symbols.generation,
+        };
+
+        if (shown->drawn && shown->address == now.address &&
+            shown->value == now.value &&
+            shown->attributes == now.attributes &&
+            shown->generation == now.generation) {
+                return;
+        }
+
+        // Rows are cut short at the border, so they never spill onto the
+        // next one.
+        wattrset(window, (int) attributes);
+        mvwaddnstr(window, row + 1, 1, memoryRow(program, address, value),
+                   getmaxx(window) - 2);
+        wattrset(window, A_NORMAL);
+
+        *shown = now;
+}
+
+/*
+ * Bring every row of the memory view up to date, and send whatever changed to
+ * the terminal in one go. Memory is read from the live snapshot if there is
+ * one, and rows it doesn't reach are left as they are.
+ */
+
+static void redraw(WINDOW *window, struct program *program,
+                   struct memoryView *view, struct snapshot const *live)
+{
+        uint16_t const top = (uint16_t) (view->address - view->selected);
+
+        for (int i = 0; i < view->height; ++i) {
+                uint16_t const address = (uint16_t) (top + i);
+                unsigned attributes = 0;
+                uint16_t value;
+                bool isBreakpoint;
+
+                if (NULL == live) {
+                        value = program->simulator.memory[address].value;
+                        isBreakpoint =
+                                program->simulator.memory[address].isBreakpoint;
+                } else {
+                        unsigned const offset =
+                                (uint16_t) (address - live->first);
+
+                        if (offset >= LIVE_WORDS) {
+                                continue;
+                        }
+
+                        value = live->words[offset];
+                        isBreakpoint = live->breakpoints[offset / 64] >>
+                                       (offset % 64) & 1;
+                }
+
+                if (i == view->selected) {
+                        attributes = SELECTED_ATTRIBUTES;
+                } else if (isBreakpoint) {
+                        attributes = BREAKPOINT_ATTRIBUTES;
+                }
+
+                drawRow(window, program, view, i, address, value, attributes);
+        }
+
+        wnoutrefresh(window);
+        doupdate();
+}
+
+void update(WINDOW *window, struct program *program, struct memoryView *view)
+{
+        view->output[view->selected] =
+                program->simulator.memory[view->address].value;
+        redraw(window, program, view, NULL);
+}
+
+/*
+ * Given a currently selected index and address, populate the view's output
+ * array to contain relative values.
+ */
+
+void generateContext(WINDOW *window, struct program *program,
+                     struct memoryView *view, int selected,
+                     uint16_t selectedAddress)
+{
+        int i = 0;
+        int const height = view->height;
+
+        selected =
+                ((selectedAddress + (height - 1 - selected)) > 0xfffe) ?
+                (height - (0xfffe - selectedAddress)) - 1 : selected;
+
+        view->selected = selected;
+        view->address = selectedAddress;
+
+        for (; i < selected; i++)
+                view->output[i] = program->simulator.memory[
+                        selectedAddress - selected + i].value;
+        for (; i < height; i++)
+                view->output[i] = program->simulator.memory[
+                        selectedAddress + i].value;
+
+        redraw(window, program, view, NULL);
+        view->populated = selectedAddress;
+}
+
+/*
+ * Show the memory around the PC of a running machine, as of its latest
+ * snapshot, with the PC selected.
+ */
+
+void liveContext(WINDOW *window, struct program *program,
+                 struct memoryView *view, struct snapshot const *live)
+{
+        int const height = view->height;
+
+        view->selected = (live->PC + (height - 1)) > 0xfffe ?
+                         (height - (0xfffe - live->PC)) - 1 : 0;
+        view->address = live->PC;
+
+        redraw(window, program, view, live);
+        view->populated = live->PC;
+}
+
+void moveContext(WINDOW *window, struct program *program,
+                 struct memoryView *view, enum DIRECTION direction)
+{
+        bool _redraw = false;
+
+        switch (direction) {
+        case UP:
+                view->address -= view->address != 0;
+                view->selected = !view->selected ? _redraw = true, 0 :
+                        view->selected - 1;
+                break;
+        case DOWN:
+                view->address += (0xFFFE == view->address) ? 0 : 1;
+                view->selected = ((view->height - 1) == view->selected) ?
+                        _redraw = true, (view->height - 1) :
+                        view->selected + 1;
+                break;
+        default:
+                break;
+        }
+
+        if (_redraw) {
+                generateContext(window, program, view, view->selected,
+                                view->address);
+        } else {
+                redraw(window, program, view, NULL);
+        }
+}
+
@@ -0,0 +1,113 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Error.h"
+#include "Parser.h"
+
+/*
+ * Assembles the Operating System while we're being built, and writes it out as
+ * C, to be compiled in as the built in Operating System (see OS.h).
+ *
+ * This is linked against an assembler that has no Operating System of its
+ * own, so nothing is known about before the Operating System says so.
+ */
+
+/*
+ * Join two strings together in freshly allocated memory, as the program struct
+ * expects to free its file names.
+ */
+
+static char *join(char const *first, char const *second)
+{
+        char *joined = malloc(strlen(first) + strlen(second) + 1);
+        if (NULL == joined) {
+                perror("lc3embed");
+                exit(EXIT_FAILURE);
+        }
+
+        strcpy(joined, first);
+        strcat(joined, second);
+
+        return joined;
+}
+
+/*
+ * Write the words of the object file as an array.
+ */
+
+static void writeWords(FILE *object, FILE *file)
+{
+        unsigned char bytes[2];
+        size_t count = 0;
+
+        fprintf(file, "uint16_t const builtinOS[] = {");
+        while (1 == fread(bytes, sizeof(bytes), 1, object)) {
+                fprintf(file, "%s0x%02X%02X,", count % 8 ? " " : "\n\t",
+                        bytes[0], bytes[1]);
+                count++;
+        }
+        fprintf(file, "\n};\n\n");
+        fprintf(file, "size_t const builtinOSLength = %zu;\n\n", count);
+}
+
+static void writeSymbols(struct program const *program, FILE *file)
+{
+        struct symbolTable const *table = &program->symbols;
+
+        fprintf(file, "struct OSSymbol const builtinOSSymbols[] = {\n");
+        for (size_t i = 0; i < table->count; i++) {
+                fprintf(file, "\t{ \"%s\", 0x%04X },\n",
+                        table->symbols[i]->name, table->symbols[i]->address);
+        }
+        fprintf(file, "};\n\n");
+        fprintf(file, "size_t const builtinOSSymbolCount = %zu;\n",
+                table->count);
+}
+
+int main(int argc, char **argv)
+{
+        if (3 != argc) {
+                fprintf(stderr, "Usage: %s LC3_OS.asm OSImage.c\n", argv[0]);
+                exit(EXIT_FAILURE);
+        }
+
+        // Only the object file is written, and it's written next to the C,
+        // rather than in the source tree.
+        struct program program = {
+                .assemblyfile = join(argv[1], ""),
+                .objectfile   = join(argv[2], ".obj"),
+                .formats      = FORMAT_OBJ,
+                .warn         = false,
+        };
+
+        if (!parse(&program)) {
+                tidyUp(&program);
+                exit(EXIT_FAILURE);
+        }
+
+        FILE *object = fopen(program.objectfile, "rb");
+        FILE *file = fopen(argv[2], "w");
+        if (NULL == object || NULL == file) {
+                perror("lc3embed");
+                exit(EXIT_FAILURE);
+        }
+
+        char const *name = strrchr(argv[1], '/');
+
+        fprintf(file, "// Generated from %s by lc3embed. Don't edit it.\n\n",
+                NULL != name ? name + 1 : argv[1]);
+        fprintf(file, "#include \"OS.h\"\n\n");
+        writeWords(object, file);
+        writeSymbols(&program, file);
+
+        fclose(object);
+        if (fclose(file)) {
+                perror("lc3embed");
+                exit(EXIT_FAILURE);
+        }
+
+        tidyUp(&program);
+
+        return EXIT_SUCCESS;
+}
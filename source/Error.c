@@ -2,6 +2,8 @@
 #include <stdio.h>
 
 #include "Error.h"
+#include "Memory.h"
+#include "Parser.h"
 
 /*
  * Failed to read to the end of the file for some reason,
@@ -39,5 +41,11 @@ void tidyUp(struct program *program)
         if (NULL != program->logfile) {
                 free(program->logfile);
         }
+        if (NULL != program->pristine) {
+                free(program->pristine);
+        }
+
+        freeRows(program);
+        freeTable(program);
 }
 
@@ -1,4 +1,11 @@
+#ifdef __linux__
+#define _XOPEN_SOURCE 700
+#endif
+
 #include <stdbool.h> // Much nicer to use true/false
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
 
 #include "Enums.h"
 #include "LC3.h"
@@ -23,43 +30,74 @@ static void set_condition_code(uint16_t *last_result, unsigned char *CC)
 }
 
 /*
- * Print the current state of the simulator to the window provided.
+ * Read a word of the simulator's memory.
+ */
+
+uint16_t readMemory(struct LC3 const *simulator, uint16_t address)
+{
+        return simulator->memory[address].value;
+}
+
+/*
+ * Note that the page holding the given address has changed since it was
+ * loaded.
  */
 
-void printState(struct LC3 *simulator, WINDOW *window)
+void markDirty(struct LC3 *simulator, uint16_t address)
 {
-        size_t index = 0;
+        simulator->dirtyPages[address >> PAGE_BITS >> 6] |=
+                (uint64_t) 1 << (address >> PAGE_BITS & 63);
+}
 
-        // Clear, and re-border, the window.
-        wclear(window);
-        box(window, 0, 0);
+/*
+ * Store a value into memory, keeping count of whether memory actually
+ * changed.
+ */
 
-        // Print the first four registers.
-        for (; index < 4; ++index) {
-                mvwprintw(window, (int) index + 1, 3, "R%d 0x%04X %hd", index,
-                        simulator->registers[index],
-                        simulator->registers[index]);
+void writeMemory(struct LC3 *simulator, uint16_t address, uint16_t value)
+{
+        if (simulator->memory[address].value != value) {
+                simulator->memory[address].value = value;
+                simulator->changes++;
+                markDirty(simulator, address);
         }
+}
+
+/*
+ * Called whenever we branch backwards, to what is presumably the head of a
+ * loop. If the registers are exactly the same as the last time we were here,
+ * and nothing has been stored or read in between, then the machine is in the
+ * same state it was and will keep coming back here forever.
+ */
 
-        // Print the last 4 registers.
-        for (; index < 8; ++index) {
-                mvwprintw(window, (int) index - 3, 20, "R%d 0x%04X %hd", index,
-                        simulator->registers[index],
-                        simulator->registers[index]);
+static void checkForHang(struct LC3 *simulator)
+{
+        struct loopHead *head =
+                &simulator->loopHeads[simulator->PC & (LOOP_HEADS - 1)];
+
+        if (head->seen && head->PC == simulator->PC &&
+            head->changes == simulator->changes &&
+            head->CC == simulator->CC &&
+            !memcmp(head->registers, simulator->registers,
+                    sizeof(simulator->registers))) {
+                simulator->isHung = true;
+                return;
         }
 
-        // Print the PC, IR, and CC.
-        mvwprintw(window, 1, 37, "PC 0x%04X %hd", simulator->PC, simulator->PC);
-        mvwprintw(window, 2, 37, "IR 0x%04X %hd", simulator->IR, simulator->IR);
-        mvwprintw(window, 3, 37, "CC %C        ", simulator->CC);
-        wrefresh(window);
+        head->seen = true;
+        head->PC = simulator->PC;
+        head->CC = simulator->CC;
+        head->changes = simulator->changes;
+        memcpy(head->registers, simulator->registers,
+               sizeof(simulator->registers));
 }
 
 /*
- * Execute the next instruction of the given simulator.
+ * Execute the next instruction of the given simulator, using the console
+ * provided for any keyboard input or display output.
  */
 
-void executeNext(struct LC3 *simulator, WINDOW *output)
+void step(struct LC3 *simulator, struct console const *console)
 {
         int16_t PC_offset;
         uint16_t *DR, SR1, SR2, opcode;
@@ -94,9 +132,15 @@ void executeNext(struct LC3 *simulator, WINDOW *output)
                 // memory, and then load the value stored at that address into
                 // the destination register.
                 if (KBDR == simulator->memory[simulator->PC + PC_offset].value) {
-                        wtimeout(output, -1);
-                        *DR = (uint16_t) wgetch(output);
-                        wtimeout(output, 0);
+                        int c = console->read(console->data);
+                        // Once the input has run dry, a program that still
+                        // wants more will wait forever.
+                        if (EOF == c) {
+                                simulator->isHung = simulator->detectHangs;
+                        } else {
+                                simulator->changes++;
+                        }
+                        *DR = (uint16_t) (EOF == c ? 0 : c);
                 } else {
                         *DR = simulator->memory[
                                 simulator->memory[
@@ -161,6 +205,10 @@ void executeNext(struct LC3 *simulator, WINDOW *output)
                         // Which is then added to the current program counter.
                         simulator->PC =
                                 (uint16_t) ((int16_t) simulator->PC + PC_offset);
+                        // Only loops branch backwards.
+                        if (PC_offset < 0 && simulator->detectHangs) {
+                                checkForHang(simulator);
+                        }
                 }
                 break;
         case LDR:
@@ -173,20 +221,19 @@ void executeNext(struct LC3 *simulator, WINDOW *output)
         case ST:
                 SR1 = simulator->registers[(simulator->IR >> 9) & 7];
                 PC_offset = ((int16_t) ((simulator->IR & 0x1FF) << 7)) >> 7;
-                simulator->memory[simulator->PC + PC_offset].value = SR1;
+                writeMemory(simulator, (uint16_t) (simulator->PC + PC_offset), SR1);
                 break;
         case STR:
                 SR1 = simulator->registers[(simulator->IR >> 9) & 7];
                 SR2 = simulator->registers[(simulator->IR >> 6) & 7];
                 PC_offset = ((int16_t) ((simulator->IR & 0x3F) << 9)) >> 9;
-                simulator->memory[SR2 + PC_offset].value = SR1;
+                writeMemory(simulator, (uint16_t) (SR2 + PC_offset), SR1);
                 break;
         case STI:
                 SR1 = simulator->registers[(simulator->IR >> 9) & 7];
                 PC_offset = ((int16_t) ((simulator->IR & 0x1FF) << 7)) >> 7;
-                simulator->memory[
-                        simulator->memory[
-                                simulator->PC + PC_offset].value].value = SR1;
+                writeMemory(simulator,
+                        simulator->memory[simulator->PC + PC_offset].value, SR1);
                 if (MCR == simulator->memory[simulator->PC + PC_offset].value) {
                         simulator->isHalted = true;
                 }
@@ -212,7 +259,8 @@ void executeNext(struct LC3 *simulator, WINDOW *output)
         }
 
         if (simulator->memory[DDR].value) {
-                wechochar(output, (const chtype) (simulator->memory[DDR].value & 0xFF));
+                console->write(console->data,
+                        (char) (simulator->memory[DDR].value & 0xFF));
                 simulator->memory[DDR].value = 0x0;
         }
 
@@ -220,3 +268,46 @@ void executeNext(struct LC3 *simulator, WINDOW *output)
         simulator->memory[DSR].value = 0x8000;
 }
 
+static double now(void)
+{
+        struct timespec time;
+
+        clock_gettime(CLOCK_MONOTONIC, &time);
+
+        return (double) time.tv_sec + (double) time.tv_nsec / 1e9;
+}
+
+/*
+ * Run the simulator until it halts, or until it hits one of the given limits.
+ *
+ * The clock is only looked at every few thousand instructions, so a time
+ * limit may be overrun by a fraction of a millisecond.
+ */
+
+enum RUN_RESULT run(struct LC3 *simulator, struct console const *console,
+                    struct limits const *limits)
+{
+        unsigned long long executed = 0;
+        double deadline = limits->seconds > 0 ? now() + limits->seconds : 0;
+
+        simulator->detectHangs = limits->detectHangs;
+
+        while (!simulator->isHalted) {
+                if (limits->instructions && executed == limits->instructions) {
+                        return RUN_BUDGET;
+                }
+
+                if (deadline > 0 && !(executed & 0xfff) && now() > deadline) {
+                        return RUN_TIMEOUT;
+                }
+
+                step(simulator, console);
+                executed++;
+
+                if (simulator->isHung) {
+                        return RUN_HUNG;
+                }
+        }
+
+        return RUN_HALTED;
+}
@@ -31,14 +31,11 @@
 
 unsigned int logDump(struct program const *program)
 {
-        static bool beenHere = false;
         FILE *logfile;
 
-        if (!beenHere && NULL == program->logfile)
+        if (NULL == program->logfile)
                 return ErrNoFile;
 
-        beenHere = true;
-
         logfile = fopen(program->logfile, "a");
 
         if (NULL == logfile)
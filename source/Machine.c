@@ -5,11 +5,17 @@
 #include "Machine.h"
 #include "Logging.h"
 #include "Memory.h"
+#include "Display.h"
 #include "LC3.h"
+#include "Error.h"
+#include "Worker.h"
+
+// How often the simulator view is drawn while the machine is running, unless
+// the program says otherwise.
+#define FRAME_RATE 30
 
 static WINDOW *status, *output, *context;
 static int MESSAGE_WIDTH, MESSAGE_HEIGHT;
-int memPopulated = -1;
 
 static struct LC3 const init_state = {
         .CC        =    'Z',
@@ -47,6 +53,8 @@ static int init_machine(struct program *program)
                         program->objectfile);
         }
 
+        snapshotMachine(program);
+
         return ret;
 }
 
@@ -61,7 +69,7 @@ static void set_state(enum STATE *currentState)
                 (MAIN == *currentState) ? "Main View" :
                 (SIM == *currentState) ? "Simulator" :
                 /* Default */     "Unknown");
-        refresh();
+        wnoutrefresh(stdscr);
 
         touchwin(status);
         touchwin(output);
@@ -107,69 +115,209 @@ static int popup_window(char const *message, int original_value, bool ignore)
         return ret;
 }
 
+/*
+ * Like popup_window(), but for reading a line of text instead of a number.
+ */
+
+static void popup_text(char const *message, char *buffer, int size)
+{
+        int message_width = MESSAGE_WIDTH + (int) strlen(message);
+
+        WINDOW *popup = newwin(MESSAGE_HEIGHT, message_width,
+                (LINES - MESSAGE_HEIGHT) / 2, (COLS - message_width) / 2);
+
+        box(popup, 0, 0);
+        echo();
+
+        mvwaddstr(popup, 2, 1, message);
+        wgetnstr(popup, buffer, size - 1);
+        buffer[size - 1] = '\0';
+
+        noecho();
+        delwin(popup);
+}
+
+/*
+ * Find the next (or previous) match for the last search, and bring it into
+ * view.
+ */
+
+static void find(WINDOW *window, struct program *program,
+                 struct memoryView *view, bool forward)
+{
+        long found;
+
+        if (!view->searching) {
+                popup_window("Nothing to search for.", 0, true);
+                return;
+        }
+
+        found = searchMemory(&program->simulator, &view->search, view->address,
+                forward);
+        if (-1 == found) {
+                popup_window("Not found.", 0, true);
+                return;
+        }
+
+        generateContext(window, program, view, 0, (uint16_t) found);
+}
+
+/*
+ * Show whatever the worker has printed.
+ */
+
+static void show_output(struct worker *worker, WINDOW *out)
+{
+        char c;
+        bool shown = false;
+
+        while (readOutput(worker, &c)) {
+                waddch(out, (chtype) (unsigned char) c);
+                shown = true;
+        }
+
+        if (shown) {
+                wnoutrefresh(out);
+        }
+}
+
+/*
+ * Wait for the worker to get through everything it's been sent, and stop,
+ * so that the program's memory can be looked at.
+ */
+
+static void settle(struct worker *worker)
+{
+        takeSnapshot(worker);
+
+        while (!workerSettled(worker)) {
+                show_output(worker, output);
+                napms(1);
+                takeSnapshot(worker);
+        }
+
+        show_output(worker, output);
+}
+
+/*
+ * Draw a frame of the simulator view from the worker's latest snapshot.
+ *
+ * Returns: true if nothing will change until the worker is sent something.
+ */
+
+static bool draw_frame(WINDOW *out, WINDOW *state, struct program *program,
+                       struct worker *worker, struct memoryView *view,
+                       struct stateView *shown, enum STATE *current_state)
+{
+        bool settled;
+
+        // Whatever was printed is taken even in turbo, so the worker never
+        // waits for room, but it's only sent to the terminal by doupdate().
+        show_output(worker, out);
+        takeSnapshot(worker);
+        settled = workerSettled(worker);
+
+        if (program->turbo && !settled) {
+                return false;
+        }
+
+        printState(&worker->latest, state, shown);
+
+        if (worker->latest.breakpointsHit != worker->breakpointsShown) {
+                worker->breakpointsShown = worker->latest.breakpointsHit;
+                doupdate();
+                popup_window("Breakpoint hit!", 0, true);
+                // Put back what the popup covered.
+                set_state(current_state);
+        }
+
+        // The status pane and the memory view go to the terminal together,
+        // with the view. Memory can be read directly once the worker has
+        // stopped, but until then it comes from the snapshot.
+        if (settled && WORKER_IDLE == worker->latest.state) {
+                generateContext(context, program, view, 0, worker->latest.PC);
+        } else {
+                liveContext(context, program, view, &worker->latest);
+        }
+
+        return settled;
+}
+
 static bool simulator_view(WINDOW *out, WINDOW *state, struct program *program,
-                           enum STATE *current_state)
+                           struct worker *worker, struct memoryView *view,
+                           struct stateView *shown, enum STATE *current_state)
 {
-        int input;
-        static int timeout = 0;
+        int input, count;
+        int const period = 1000 / (int) (program->frameRate ?
+                                         program->frameRate : FRAME_RATE);
 
         set_state(current_state);
 
         while (1) {
-                wtimeout(state, timeout);
-                input = wgetch(status);
-
-                if (program->simulator.memory[program->simulator.PC].isBreakpoint) {
-                        popup_window("Breakpoint hit!", 0, true);
-                        program->simulator.isPaused = true;
-                        program->simulator.memory[program->simulator.PC]
-                                .isBreakpoint = false;
-                }
+                // While the machine runs, the view is drawn at a steady rate
+                // rather than after every instruction.
+                wtimeout(state, draw_frame(out, state, program, worker, view,
+                                           shown, current_state) ?
+                                -1 : period);
+                input = wgetch(state);
 
-                if (QUIT == input) {
+                if (ERR == input) {
+                        continue;
+                } else if (WORKER_READING == worker->latest.state) {
+                        // The program is waiting for a key, so it gets this
+                        // one.
+                        sendCommand(worker, COMMAND_INPUT, 0, (uint16_t) input);
+                } else if (QUIT == input) {
                         return false;
                 } else if (GOBACK == input) {
                         *current_state = MAIN;
-                        program->simulator.isPaused = true;
+                        sendCommand(worker, COMMAND_PAUSE, 0, 0);
                         return true;
                 } else if (PAUSE == input) {
-                        program->simulator.isPaused = !program->simulator.isPaused;
+                        sendCommand(worker, WORKER_RUNNING ==
+                                    worker->latest.state ?
+                                    COMMAND_PAUSE : COMMAND_RUN, 0, 0);
                 } else if (START == input || RUN == input) {
-                        program->simulator.isPaused = program->simulator.isHalted;
+                        sendCommand(worker, COMMAND_RUN, 0, 0);
                 } else if (RESTART == input) {
-                        memPopulated = -1;
-                        init_machine(program);
+                        view->populated = -1;
+                        sendCommand(worker, COMMAND_RESET, 0, 0);
+                        settle(worker);
                         wclear(out);
                         wrefresh(out);
+                } else if (TURBO == input) {
+                        program->turbo = !program->turbo;
                 } else if (STEP_NEXT == input) {
-                        executeNext(&(program->simulator), output);
-                        program->simulator.isPaused = true;
-                        printState(&(program->simulator), state);
+                        sendCommand(worker, COMMAND_STEP, 0, 0);
+                } else if (STEP_OVER == input) {
+                        sendCommand(worker, COMMAND_STEP_OVER, 0, 0);
+                } else if (STEP_OUT == input) {
+                        sendCommand(worker, COMMAND_STEP_OUT, 0, 0);
+                } else if (RUN_FOR == input) {
+                        count = popup_window(
+                                "Enter how many instructions to run (in hex): ",
+                                0, false);
+                        if (count > 0) {
+                                sendCommand(worker, COMMAND_RUN_FOR, 0,
+                                        (uint32_t) count);
+                        }
+                        // Put back what the popup covered.
+                        set_state(current_state);
                 } else if (CONTINUE == input) {
-                        memPopulated = -1;
-                        init_machine(program);
+                        view->populated = -1;
+                        sendCommand(worker, COMMAND_RESET, 0, 0);
                 } else if (CONTINUE_RUN == input) {
-                        memPopulated = -1;
-                        init_machine(program);
-                        program->simulator.isPaused = false;
-                }
-
-                if (!program->simulator.isPaused && !program->simulator.isHalted) {
-                        executeNext(&(program->simulator), out);
-                        timeout = 0;
-                } else {
-                        set_state(current_state);
-                        printState(&(program->simulator), state);
-                        timeout = -1;
-                        generateContext(context, program, 0, program->simulator.PC);
+                        view->populated = -1;
+                        sendCommand(worker, COMMAND_RESET, 0, 0);
+                        sendCommand(worker, COMMAND_RUN, 0, 0);
                 }
         }
 }
 
 static bool main_view(WINDOW *state, enum STATE *current_state,
-                      struct program *program)
+                      struct program *program, struct worker *worker)
 {
-        int input;
+        int input, failed;
 
         while (1) {
                 set_state(current_state);
@@ -177,6 +325,9 @@ static bool main_view(WINDOW *state, enum STATE *current_state,
                 if (QUIT == input) {
                         return false;
                 } else if (LOGDUMP == input) {
+                        // The machine is only dumped once the worker has
+                        // stopped changing it.
+                        settle(worker);
                         if (logDump(program)) {
                                 return false;
                         }
@@ -189,7 +340,10 @@ static bool main_view(WINDOW *state, enum STATE *current_state,
                 } else if (FILESEL == input) {
                         prompt((char const *) NULL, "Enter the .obj file: ",
                                 program->objectfile);
-                        if (init_machine(program)) {
+                        stopWorker(worker);
+                        failed = init_machine(program);
+                        startWorker(worker, program);
+                        if (failed) {
                                 return false;
                         }
                 }
@@ -197,13 +351,18 @@ static bool main_view(WINDOW *state, enum STATE *current_state,
 }
 
 static bool memory_view(WINDOW *window, struct program *program,
+                        struct worker *worker, struct memoryView *view,
                         enum STATE *current_state)
 {
         int input, jump_address, new_value;
+        char text[SEARCH_LENGTH + 1];
 
         while (1) {
                 set_state(current_state);
                 input = wgetch(window);
+                // Memory can only be looked at while the worker leaves it
+                // alone.
+                settle(worker);
                 if (QUIT == input) {
                         return false;
                 } else if (GOBACK == input) {
@@ -212,28 +371,47 @@ static bool memory_view(WINDOW *window, struct program *program,
                 } else if (JUMP == input) {
                         jump_address = popup_window(
                                 "Enter a hex address to jump to: ",
-                                selectedAddress, false);
-                        if (jump_address == selectedAddress)
+                                view->address, false);
+                        if (jump_address == view->address)
                                 continue;
-                        generateContext(window, program, 0, (uint16_t) jump_address);
+                        generateContext(window, program, view, 0,
+                                (uint16_t) jump_address);
                 } else if (KEYUP == input) {
-                        moveContext(window, program, UP);
+                        moveContext(window, program, view, UP);
                 } else if (KEYDOWN == input) {
-                        moveContext(window, program, DOWN);
+                        moveContext(window, program, view, DOWN);
                 } else if (EDITFILE == input) {
                         new_value = popup_window(
                                 "Enter the new instruction (in hex): ",
-                                program->simulator.memory[selectedAddress].value,
+                                readMemory(&program->simulator, view->address),
                                 false);
-                        program->simulator.memory[selectedAddress].value =
-                                (uint16_t) new_value;
-                        update(window, program);
+                        sendCommand(worker, COMMAND_WRITE, view->address,
+                                (uint16_t) new_value);
+                        settle(worker);
+                        update(window, program, view);
                 } else if (SETPC == input) {
-                        program->simulator.PC = selectedAddress;
+                        sendCommand(worker, COMMAND_SET_PC, view->address, 0);
                 } else if (BREAKPOINTSET == input) {
-                        program->simulator.memory[selectedAddress]
-                                .isBreakpoint = !program->simulator.memory[
-                                selectedAddress].isBreakpoint;
+                        sendCommand(worker, COMMAND_TOGGLE_BREAKPOINT,
+                                view->address, 0);
+                } else if (RUN_TO == input) {
+                        // It's run where it can be watched.
+                        sendCommand(worker, COMMAND_RUN_TO, view->address, 0);
+                        *current_state = SIM;
+                        return true;
+                } else if (FIND == input) {
+                        popup_text("Search for (hex, bits with x's, or "
+                                "\"text\"): ", text, (int) sizeof(text));
+                        view->searching = parseSearch(text, &view->search);
+                        if (!view->searching) {
+                                popup_window("Invalid search.", 0, true);
+                                continue;
+                        }
+                        find(window, program, view, true);
+                } else if (FIND_NEXT == input) {
+                        find(window, program, view, true);
+                } else if (FIND_PREVIOUS == input) {
+                        find(window, program, view, false);
                 }
         }
 }
@@ -242,44 +420,58 @@ static void run_machine(struct program *program)
 {
         bool simulating = true;
         enum STATE currentState = MAIN;
-
-        outputHeight = (uint16_t) (2 * (LINES - 6) / 3 - 2);
-        memoryOutput = malloc(sizeof(uint16_t) * outputHeight);
-        if (NULL == memoryOutput) {
+        struct memoryView view = {
+                .height    = (uint16_t) (2 * (LINES - 6) / 3 - 2),
+                .populated = -1,
+        };
+        struct stateView shown = {
+                .drawn = false,
+        };
+        struct worker worker;
+
+        view.output = malloc(sizeof(uint16_t) * view.height);
+        view.shown = calloc(view.height, sizeof(struct shownRow));
+        if (NULL == view.output || NULL == view.shown) {
                 perror("LC3-Simulator");
                 exit(EXIT_FAILURE);
         }
 
-        generateContext(context, program, 0, program->simulator.PC);
+        generateContext(context, program, &view, 0, program->simulator.PC);
+        startWorker(&worker, program);
 
         while (simulating) {
                 set_state(&currentState);
 
                 switch (currentState) {
                 case MAIN:
-                        simulating = main_view(status, &currentState, program);
+                        simulating = main_view(status, &currentState, program,
+                                &worker);
                         break;
                 case SIM:
                         simulating = simulator_view(output, status, program,
-                                &currentState);
+                                &worker, &view, &shown, &currentState);
                         break;
                 case MEM:
-                        if (-1 == memPopulated) {
-                                generateContext(context, program, 0,
+                        settle(&worker);
+                        if (-1 == view.populated) {
+                                generateContext(context, program, &view, 0,
                                         program->simulator.PC);
                         } else {
-                                generateContext(context, program, selected,
-                                        (uint16_t) memPopulated);
+                                generateContext(context, program, &view,
+                                        view.selected,
+                                        (uint16_t) view.populated);
                         }
-                        simulating = memory_view(context, program, &currentState);
+                        simulating = memory_view(context, program, &worker,
+                                &view, &currentState);
                         break;
                 default:
                         break;
                 }
         }
 
-        free(memoryOutput);
-        memoryOutput = NULL;
+        stopWorker(&worker);
+        free(view.output);
+        free(view.shown);
 }
 
 static void exit_handle(void)
@@ -290,10 +482,6 @@ static void exit_handle(void)
         delwin(output);
         delwin(context);
         endwin();
-
-        if (NULL != memoryOutput) {
-                free(memoryOutput);
-        }
 }
 
 void startMachine(struct program *program)
@@ -339,3 +527,61 @@ void startMachine(struct program *program)
         endwin();
 }
 
+static int standardRead(void *data)
+{
+        (void) data;
+        return getchar();
+}
+
+static void standardWrite(void *data, char c)
+{
+        (void) data;
+        putchar(c);
+}
+
+/*
+ * Run the program without the interface, reading from stdin and writing to
+ * stdout, until it halts or reaches one of the program's limits. The return
+ * value is suitable as an exit status.
+ */
+
+int runUnattended(struct program *program)
+{
+        struct console const console = {
+                .read  = standardRead,
+                .write = standardWrite,
+                .data  = NULL,
+        };
+
+        if (NULL == program->objectfile) {
+                fprintf(stderr, "No .obj file to run.\n");
+                return EXIT_FAILURE;
+        }
+
+        program->simulator = init_state;
+        if (populateMemory(program)) {
+                return EXIT_FAILURE;
+        }
+
+        enum RUN_RESULT result = run(&program->simulator, &console,
+                                     &program->limits);
+
+        fflush(stdout);
+
+        switch (result) {
+        case RUN_BUDGET:
+                fprintf(stderr, "Instruction limit reached at PC 0x%04X.\n",
+                        program->simulator.PC);
+                return EXIT_BUDGET;
+        case RUN_TIMEOUT:
+                fprintf(stderr, "Time limit reached at PC 0x%04X.\n",
+                        program->simulator.PC);
+                return EXIT_TIMEOUT;
+        case RUN_HUNG:
+                fprintf(stderr, "Program stopped making progress at PC 0x%04X.\n",
+                        program->simulator.PC);
+                return EXIT_HUNG;
+        default:
+                return EXIT_SUCCESS;
+        }
+}
@@ -2,13 +2,18 @@
 #define _XOPEN_SOURCE 500
 #endif
 
+#include <ctype.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <signal.h>
 
+#include "Batch.h"
 #include "Error.h"
 #include "Parser.h"
 #include "Machine.h"
+#include "Memory.h"
 #include "OptParse.h"
 
 static struct program *program = NULL;
@@ -21,18 +26,136 @@ __attribute__((noreturn)) static void close(int sig)
                 tidyUp(program);
         }
 
-        freeTable(&tableHead);
-
         exit(EXIT_FAILURE);
 }
 
+/*
+ * Work out which files to write from a list like "obj,sym".
+ *
+ * Returns: The formats, or 0 if any of them isn't one we know of.
+ */
+
+static unsigned parseFormats(char const *list)
+{
+        static struct {
+                char const *name;
+                enum format format;
+        } const names[] = {
+                { "obj", FORMAT_OBJ },
+                { "sym", FORMAT_SYM },
+                { "hex", FORMAT_HEX },
+                { "bin", FORMAT_BIN },
+                { "symc", FORMAT_SYMC },
+        };
+        unsigned formats = 0;
+
+        while (*list) {
+                size_t length = strcspn(list, ",");
+                size_t i;
+
+                for (i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+                        if (strlen(names[i].name) == length &&
+                            !strncmp(names[i].name, list, length)) {
+                                formats |= names[i].format;
+                                break;
+                        }
+                }
+
+                if (sizeof(names) / sizeof(names[0]) == i) {
+                        return 0;
+                }
+
+                list += length;
+                list += ',' == *list;
+        }
+
+        return formats;
+}
+
+/*
+ * Read an address in hex, with or without a leading "0x" or "x".
+ *
+ * Returns: Where the address ended, or NULL if there wasn't one.
+ */
+
+static char const *parseAddress(char const *text, long *address)
+{
+        char *end = NULL;
+
+        if ('x' == *text || 'X' == *text) {
+                text++;
+        }
+
+        if (!isxdigit((unsigned char) *text)) {
+                return NULL;
+        }
+
+        *address = strtol(text, &end, 16);
+
+        return *address <= 0xFFFF ? end : NULL;
+}
+
+/*
+ * Work out the addresses of a range like "3000:30FF" (both included).
+ *
+ * Returns: true if it was a range, with first no later than last.
+ */
+
+static bool parseRange(char const *range, long *first, long *last)
+{
+        range = parseAddress(range, first);
+        if (NULL == range || ':' != *range) {
+                return false;
+        }
+
+        range = parseAddress(range + 1, last);
+
+        return NULL != range && !*range && *first <= *last;
+}
+
+/*
+ * Remember another file to assemble.
+ */
+
+static void addFile(char ***files, size_t *count, char *file)
+{
+        *files = realloc(*files, (*count + 1) * sizeof(char *));
+        if (NULL == *files) {
+                perror("LC3-Simulator");
+                exit(EXIT_FAILURE);
+        }
+
+        (*files)[(*count)++] = file;
+}
+
 __attribute__((noreturn)) static void usage(char const *const name)
 {
         printf("Usage: %s [options]                                                \n\n"
                         "Options:                                                    \n"
-                        "  -a [--assemble] file   Assemble the given file.           \n"
+                        "  -a [--assemble] file.. Assemble the given file(s). Several\n"
+                        "                         files are only assembled, at once. \n"
+                        "  -j [--jobs] n          Assemble up to n files at a time.  \n"
                         "  -v [--verbose] <level> Set the verbosity of the assembler.\n"
-                        "  -o [--assemble-only]   Only assemble the given program.   \n",
+                        "  -o [--assemble-only]   Only assemble the given program.   \n"
+                        "  -F [--formats] list    Only write these of obj,sym,hex,bin\n"
+                        "                         and symc (all of them by default). \n"
+                        "  -r [--run]             Run without the interface, using   \n"
+                        "                         stdin and stdout.                  \n"
+                        "  -m [--max-instructions] n                                 \n"
+                        "                         Stop after n instructions (exit 3).\n"
+                        "  -t [--timeout] seconds Stop after this long (exit 4).     \n"
+                        "  -d [--detect-hangs]    Stop on an endless loop (exit 5).  \n"
+                        "  -O [--os] file.obj     Use this Operating System (with the\n"
+                        "                         .sym beside it), not the built in. \n"
+                        "  -D [--disassemble] file.obj                               \n"
+                        "                         List the program, disassembled.    \n"
+                        "  -R [--range] first:last                                   \n"
+                        "                         List these addresses (in hex)      \n"
+                        "                         instead of just the program.       \n"
+                        "  -u [--frame-rate] hz   Redraw a running program this many \n"
+                        "                         times a second (30 by default).    \n"
+                        "  -T [--turbo]           Don't redraw a running program     \n"
+                        "                         until it stops.                    \n",
                 name
         );
 
@@ -51,6 +174,11 @@ int main(int argc, char **argv)
                 .objectfile   = NULL,
                 .verbosity    = 0,
                 .warn         = true,
+                .limits       = {
+                        .instructions = 0,
+                        .seconds      = 0,
+                        .detectHangs  = false,
+                },
         };
 
         program = &prog;
@@ -85,6 +213,61 @@ int main(int argc, char **argv)
                         .shortOption = 'n',
                         .option = NONE,
                 },
+                {
+                        .longOption = "run",
+                        .shortOption = 'r',
+                        .option = NONE,
+                },
+                {
+                        .longOption = "max-instructions",
+                        .shortOption = 'm',
+                        .option = REQUIRED,
+                },
+                {
+                        .longOption = "timeout",
+                        .shortOption = 't',
+                        .option = REQUIRED,
+                },
+                {
+                        .longOption = "detect-hangs",
+                        .shortOption = 'd',
+                        .option = NONE,
+                },
+                {
+                        .longOption = "formats",
+                        .shortOption = 'F',
+                        .option = REQUIRED,
+                },
+                {
+                        .longOption = "os",
+                        .shortOption = 'O',
+                        .option = REQUIRED,
+                },
+                {
+                        .longOption = "disassemble",
+                        .shortOption = 'D',
+                        .option = REQUIRED,
+                },
+                {
+                        .longOption = "range",
+                        .shortOption = 'R',
+                        .option = REQUIRED,
+                },
+                {
+                        .longOption = "jobs",
+                        .shortOption = 'j',
+                        .option = REQUIRED,
+                },
+                {
+                        .longOption = "frame-rate",
+                        .shortOption = 'u',
+                        .option = REQUIRED,
+                },
+                {
+                        .longOption = "turbo",
+                        .shortOption = 'T',
+                        .option = NONE,
+                },
                 {
                         .longOption = "help",
                         .shortOption = 'h',
@@ -96,6 +279,10 @@ int main(int argc, char **argv)
         };
 
         int option = 0;
+        char **files = NULL;
+        size_t fileCount = 0;
+        long jobs = 0;
+        long first = -1, last = -1;
 
         while ((option = parseOptions(_options, argc, argv)) != 0) {
                 switch (option) {
@@ -105,17 +292,56 @@ int main(int argc, char **argv)
                                 exit(EXIT_FAILURE);
                         }
 
-                        program->assemblyfile = strdup(returnedOption.longOption);
-                        if (NULL == program->assemblyfile) {
-                                perror(argv[0]);
+                        addFile(&files, &fileCount,
+                                (char *) returnedOption.longOption);
+                        opts |= ASSEMBLE;
+                        break;
+                case NO_OPT:
+                        // Anything else on the command line is another file
+                        // to assemble.
+                        addFile(&files, &fileCount,
+                                (char *) returnedOption.longOption);
+                        opts |= ASSEMBLE;
+                        break;
+                case 'j': {
+                        char *end = NULL;
+                        if (returnedOption.option == NONE) {
+                                fprintf(stderr, "Option --jobs requires a number.\n");
                                 exit(EXIT_FAILURE);
                         }
 
-                        opts |= ASSEMBLE;
+                        jobs = strtol(returnedOption.longOption, &end, 10);
+                        if (*end || jobs < 1) {
+                                fprintf(stderr, "Invalid number of jobs: %s\n",
+                                        returnedOption.longOption);
+                                exit(EXIT_FAILURE);
+                        }
+                        break;
+                }
+                case 'F':
+                        if (returnedOption.option == NONE) {
+                                fprintf(stderr, "Option --formats requires a list of formats.\n");
+                                exit(EXIT_FAILURE);
+                        }
+
+                        program->formats = parseFormats(returnedOption.longOption);
+                        if (!program->formats) {
+                                fprintf(stderr, "Invalid formats: %s\n",
+                                        returnedOption.longOption);
+                                exit(EXIT_FAILURE);
+                        }
                         break;
                 case 'n':
                         program->warn = false;
                         break;
+                case 'O':
+                        if (returnedOption.option == NONE) {
+                                fprintf(stderr, "Option --os requires a file.\n");
+                                exit(EXIT_FAILURE);
+                        }
+
+                        useOS(returnedOption.longOption);
+                        break;
                 case 'f':
                         if (returnedOption.option == NONE) {
                                 fprintf(stderr, "Option --objectfile requires a file.\n");
@@ -128,9 +354,93 @@ int main(int argc, char **argv)
                                 exit(EXIT_FAILURE);
                         }
                         break;
+                case 'D':
+                        if (returnedOption.option == NONE) {
+                                fprintf(stderr, "Option --disassemble requires a file.\n");
+                                exit(EXIT_FAILURE);
+                        }
+
+                        free(program->objectfile);
+                        program->objectfile = strdup(returnedOption.longOption);
+                        if (NULL == program->objectfile) {
+                                perror(argv[0]);
+                                exit(EXIT_FAILURE);
+                        }
+                        opts |= DISASSEMBLE;
+                        break;
+                case 'R':
+                        if (returnedOption.option == NONE) {
+                                fprintf(stderr, "Option --range requires a range.\n");
+                                exit(EXIT_FAILURE);
+                        }
+
+                        if (!parseRange(returnedOption.longOption, &first, &last)) {
+                                fprintf(stderr, "Invalid range: %s\n",
+                                        returnedOption.longOption);
+                                exit(EXIT_FAILURE);
+                        }
+                        break;
                 case 'o':
                         opts |= ASSEMBLE_ONLY;
                         break;
+                case 'r':
+                        opts |= HEADLESS;
+                        break;
+                case 'm': {
+                        char *end = NULL;
+                        if (returnedOption.option == NONE) {
+                                fprintf(stderr, "Option --max-instructions requires a number.\n");
+                                exit(EXIT_FAILURE);
+                        }
+
+                        program->limits.instructions = strtoull(
+                                returnedOption.longOption, &end, 10);
+                        if (*end || !program->limits.instructions) {
+                                fprintf(stderr, "Invalid instruction limit: %s\n",
+                                        returnedOption.longOption);
+                                exit(EXIT_FAILURE);
+                        }
+                        break;
+                }
+                case 't': {
+                        char *end = NULL;
+                        if (returnedOption.option == NONE) {
+                                fprintf(stderr, "Option --timeout requires a number of seconds.\n");
+                                exit(EXIT_FAILURE);
+                        }
+
+                        program->limits.seconds = strtod(
+                                returnedOption.longOption, &end);
+                        if (*end || program->limits.seconds <= 0) {
+                                fprintf(stderr, "Invalid timeout: %s\n",
+                                        returnedOption.longOption);
+                                exit(EXIT_FAILURE);
+                        }
+                        break;
+                }
+                case 'd':
+                        program->limits.detectHangs = true;
+                        break;
+                case 'u': {
+                        char *end = NULL;
+                        if (returnedOption.option == NONE) {
+                                fprintf(stderr, "Option --frame-rate requires a number.\n");
+                                exit(EXIT_FAILURE);
+                        }
+
+                        long rate = strtol(returnedOption.longOption, &end, 10);
+                        if (*end || rate < 1 || rate > 1000) {
+                                fprintf(stderr, "Invalid frame rate: %s\n",
+                                        returnedOption.longOption);
+                                exit(EXIT_FAILURE);
+                        }
+
+                        program->frameRate = (unsigned) rate;
+                        break;
+                }
+                case 'T':
+                        program->turbo = true;
+                        break;
                 case 'v':
                         if (returnedOption.option == OPTIONAL) {
                                 char *end = NULL;
@@ -159,15 +469,49 @@ int main(int argc, char **argv)
                 }
         }
 
+        int status = EXIT_SUCCESS;
+
+        if (fileCount > 1) {
+                if (assembleAll(program, files, fileCount, (unsigned) jobs)) {
+                        status = EXIT_FAILURE;
+                }
+
+                free(files);
+                tidyUp(&prog);
+
+                return status;
+        } else if (1 == fileCount) {
+                program->assemblyfile = strdup(files[0]);
+                if (NULL == program->assemblyfile) {
+                        perror(argv[0]);
+                        exit(EXIT_FAILURE);
+                }
+
+                free(files);
+        }
+
+        // Running the program needs its object and symbol files, whatever
+        // else was asked for.
+        if (program->formats && !(opts & ASSEMBLE_ONLY)) {
+                program->formats |= FORMAT_OBJ | FORMAT_SYM;
+        }
+
         if (opts & ASSEMBLE && !parse(program)) {
+                status = EXIT_FAILURE;
+        } else if (opts & ASSEMBLE_ONLY) {
                 // NO_OPT
-        } else if (!(opts & ASSEMBLE_ONLY)) {
+        } else if (opts & DISASSEMBLE) {
+                if (listProgram(&prog, first, last, stdout)) {
+                        status = EXIT_FAILURE;
+                }
+        } else if (opts & HEADLESS) {
+                status = runUnattended(&prog);
+        } else {
                 startMachine(&prog);
         }
 
         tidyUp(&prog);
-        freeTable(&tableHead);
 
-        return 0;
+        return status;
 }
 
@@ -1,456 +1,462 @@
 #include <string.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
-#include "Machine.h"
 #include "Memory.h"
+#include "Disassembler.h"
 #include "Error.h"
+#include "LC3.h"
+#include "OS.h"
 #include "Parser.h"
 
 #define WORD_SIZE 2
+#define ROW_LENGTH 256
+#define ROWS_PER_PAGE (1 << PAGE_BITS)
 
-#ifndef OS_PATH
-#error "No Path has been supplied for the Operating System."
-#endif
-
-#define STR(x) #x
-#define OSPATH(path) STR(path)
-#define OS_OBJ_FILE OSPATH(OS_PATH) "/LC3_OS.obj"
+static char const *const ROW_FORMAT = "0x%04X  %s  0x%04X  %-25s %-50s";
 
-int selected = 0;
-uint16_t outputHeight = 0;
-uint16_t *memoryOutput = NULL;
-uint16_t selectedAddress = 0;
+// Every nibble, written out in binary.
+static char const binaryDigits[16][4] = {
+        "0000", "0001", "0010", "0011", "0100", "0101", "0110", "0111",
+        "1000", "1001", "1010", "1011", "1100", "1101", "1110", "1111",
+};
 
-bool OSInstalled = false;
-static bool symbolsInstalled = false;
+/*
+ * A row of the memory view as it was last shown, along with the word and the
+ * generation of the symbol table it was shown from. Anything else and it has
+ * to be shown again.
+ */
 
-static char const *const FORMAT = "0x%04X  %s  0x%04X  %-25s %-50s";
-static unsigned int const SELECTED_ATTRIBUTES = A_REVERSE | A_BOLD;
-static unsigned int const BREAKPOINT_ATTRIBUTES = COLOR_PAIR(1) | A_REVERSE;
+struct memoryRow {
+        uint16_t value;
+        unsigned generation;
+        char text[ROW_LENGTH];
+};
 
 /*
- * Install the Operating System (really, just put it into memory).
+ * The rows are kept a page at a time, as only a handful of pages are ever
+ * looked at.
  */
 
-static void installOS(struct program *program)
-{
-        uint16_t OSOrigin, tmp;
+struct memoryRows {
+        struct memoryRow *pages[PAGES];
+};
 
-        FILE *OSFile = fopen(OS_OBJ_FILE, "r");
-        if (NULL == OSFile) {
-                perror("LC3-Simulator");
-                exit(EXIT_FAILURE);
-        }
+/*
+ * The contents of an object file: the address it starts at, and the words
+ * that go there (in our byte order, rather than the file's).
+ */
 
-        if (1 != fread(&OSOrigin, WORD_SIZE, 1, OSFile)) {
-                fprintf(stderr, "Unable to read from the OS object file.\n");
-                exit(EXIT_FAILURE);
-        }
+struct image {
+        uint16_t origin;
+        size_t count;
+        uint16_t const *words;
+};
 
-        OSOrigin = (uint16_t) (0xffff & (OSOrigin << 8 | OSOrigin >> 8));
+/*
+ * Swap the bytes of every word, as object files are big endian.
+ */
 
-        while (1 == fread(&tmp, WORD_SIZE, 1, OSFile)) {
-                program->simulator.memory[OSOrigin] = (struct memorySlot) {
-                        .value = (uint16_t) (0xffff & (tmp << 8 | tmp >> 8)),
-                        .address = OSOrigin,
-                        .isBreakpoint = false,
-                };
+static void swapWords(uint16_t *words, size_t count)
+{
+        size_t i = 0;
 
-                OSOrigin++;
-        }
+#ifdef __SSE2__
+        for (; count - i >= 8; i += 8) {
+                __m128i chunk = _mm_loadu_si128((__m128i const *) &words[i]);
 
-        fclose(OSFile);
+                _mm_storeu_si128((__m128i *) &words[i],
+                                 _mm_or_si128(_mm_slli_epi16(chunk, 8),
+                                              _mm_srli_epi16(chunk, 8)));
+        }
+#endif
 
-        if (!OSInstalled) {
-                populateOSSymbols();
-                OSInstalled = true;
+        for (; i < count; i++) {
+                words[i] = (uint16_t) (words[i] << 8 | words[i] >> 8);
         }
 }
 
 /*
- * Populate the memory of the supplied simulator with the contents of
- * the provided file.
+ * Read a whole object file in one go, and check that it fits in memory.
  *
- * @program: The program we want to populate the memory of, which also contains the
- *           file we will read the memory from.
- *
- * Returns: 0 on success, >0 on failure.
+ * Returns: false (having said why) if it couldn't be read, or doesn't fit.
  */
 
-int populateMemory(struct program *program)
+static bool readImage(char const *fileName, struct image *image)
 {
-        uint16_t tmpPc, instruction;
+        struct stat status;
+        size_t size, done = 0;
+        ssize_t got;
 
-        FILE *file = fopen(program->objectfile, "rb");
-        if (NULL == file) {
+        int fd = open(fileName, O_RDONLY);
+        if (-1 == fd || -1 == fstat(fd, &status)) {
                 perror("LC3-Simulator");
-                exit(EXIT_FAILURE);
+                if (-1 != fd) {
+                        close(fd);
+                }
+                return false;
         }
 
-        installOS(program);
-        symbolsInstalled = false;
+        size = (size_t) status.st_size;
+        if (size < WORD_SIZE) {
+                fprintf(stderr, "Unable to read from %s.\n", fileName);
+                close(fd);
+                return false;
+        }
 
-        // First word (2 bytes) in the .obj file is the starting PC.
-        if (1 != fread(&tmpPc, WORD_SIZE, 1, file)) {
-                fprintf(stderr, "Unable to read from %s.\n", program->objectfile);
+        uint16_t *words = malloc(size);
+        if (NULL == words) {
+                perror("LC3-Simulator");
                 exit(EXIT_FAILURE);
         }
 
-        program->simulator.PC = tmpPc = (uint16_t) (0xffff & (tmpPc << 8 | tmpPc >> 8));
-
-        while (1 == fread(&instruction, WORD_SIZE, 1, file)) {
-                program->simulator.memory[tmpPc] = (struct memorySlot) {
-                        .value = (uint16_t) (0xffff & (instruction << 8 | instruction >> 8)),
-                        .address = tmpPc,
-                };
+        while (done < size) {
+                got = read(fd, (char *) words + done, size - done);
+                if (-1 == got && EINTR == errno) {
+                        continue;
+                } else if (got <= 0) {
+                        fprintf(stderr, "Unable to read from %s.\n",
+                                fileName);
+                        close(fd);
+                        free(words);
+                        return false;
+                }
 
-                tmpPc++;
+                done += (size_t) got;
         }
 
-        if (!feof(file)) {
-                fclose(file);
-                tidyUp(program);
-                read_error();
+        close(fd);
+
+        // A stray byte at the end, which isn't a whole word, is ignored.
+        swapWords(words, size / WORD_SIZE);
+
+        *image = (struct image) {
+                .origin = words[0],
+                .count  = size / WORD_SIZE - 1,
+                .words  = words,
+        };
+
+        if (image->count > 0x10000u - image->origin) {
+                fprintf(stderr, "%s runs past the end of memory (0xFFFF).\n",
+                        fileName);
+                free(words);
+                return false;
         }
 
-        fclose(file);
-        return 0;
+        return true;
 }
 
 /*
- * Convert a binary instruction to characters.
- *
- * @instr:   The 16 bit binary value that we want to convert.
- * @address: The address of the supplied instruction.
- * @buff:    Where we are to store the converted instruction.
- * @program: The program containing all instructions/files we need.
- *
- * Returns: The buff supplied.
+ * Put an image into memory, where it asks to go.
  */
 
-static char *instruction(uint16_t instr, uint16_t address, char *buff,
-                         struct program *program)
+static void loadImage(struct LC3 *simulator, struct image const *image)
 {
-        uint16_t opcode = (uint16_t) (instr & 0xF000);
-        int16_t offset;
-        char immediate[5];
-        struct symbol *symbol;
+        struct memorySlot *slot = &simulator->memory[image->origin];
+        uint16_t const *words = image->words + 1;
 
-        if (!symbolsInstalled) {
-                populateSymbolsFromFile(program);
-                symbolsInstalled = true;
+        for (size_t i = 0; i < image->count; i++) {
+                slot[i] = (struct memorySlot) {
+                        .value = words[i],
+                        .address = (uint16_t) (image->origin + i),
+                        .isBreakpoint = false,
+                };
         }
+}
 
-        switch (opcode) {
-        case AND:
-        case ADD:
-                strcpy(buff, AND == opcode ? "AND R" : "ADD R");
-                buff[5] = (char) (((instr >> 9) & 0x7) + 0x30);
-                strcat(buff, ", R");
-                buff[9] = (char) (((instr >> 6) & 0x7) + 0x30);
-                strcat(buff, ", ");
-
-                if (instr & 0x20) {
-                        strcat(buff, "#");
-                        snprintf(immediate, 5, "%hd",
-                                (int16_t) (((int16_t) (instr << 11)) >> 11));
-                        strcat(buff, immediate);
-                } else {
-                        strcat(buff, "R");
-                        buff[13] = (char) ((instr & 0x7) + 0x30);
-                }
-                break;
-        case JMP:
-                if (0xC1C0 == instr) {
-                        strcpy(buff, "RET");
-                } else {
-                        strcpy(buff, "JMP R");
-                        buff[5] = (char) (((instr >> 9) & 0x7) + 0x30);
-                }
-                break;
-        case BR:
-                strcpy(buff, "BR");
-                if (!(instr & 0x0E00)) {
-                        strcpy(buff, "NOP");
-                        break;
-                }
+/*
+ * The Operating System is the one built in, unless we've been given another.
+ * Either way it never changes, so a custom one is only read once, no matter
+ * how many times (or on how many threads) it's installed.
+ */
 
-                if (instr & 0x0800) {
-                        strcat(buff, "n");
-                }
-                if (instr & 0x0400) {
-                        strcat(buff, "z");
-                }
-                if (instr & 0x0200) {
-                        strcat(buff, "p");
-                }
+static char const *OSFile = NULL;
+static struct image OSImage;
+static pthread_once_t OSImageRead = PTHREAD_ONCE_INIT;
 
-                strcat(buff, " ");
-                if (instr & 0x0100) {
-                        offset = ((int16_t) (instr << 7)) >> 7;
-                        symbol = findSymbolByAddress((uint16_t) address +
-                                                     (uint16_t) offset);
-                } else {
-                        symbol = findSymbolByAddress((uint16_t) (address +
-                                                                 (instr & 0x00FF)));
-                }
+/*
+ * Use the Operating System in the given object file, and the symbol file next
+ * to it, instead of the one built in. This has to be done before anything is
+ * loaded or assembled.
+ */
 
-                if (NULL != symbol) {
-                        strcat(buff, symbol->name);
-                } else {
-                        // It should be pretty safe to assume that if we can't
-                        // find the symbol, it doesn't exist and the
-                        // 'instruction' is just a value in memory.
-                        strcpy(buff, "NOP");
-                }
-                break;
-        case JSR:
-                strcpy(buff, "JSR ");
-                if (instr & 0x0400) {
-                        offset = ((int16_t) (instr << 5)) >> 5;
-                        symbol = findSymbolByAddress((uint16_t) address +
-                                                     (uint16_t) offset);
-                } else {
-                        symbol = findSymbolByAddress((uint16_t) (address + (instr & 0x03FF)));
-                }
+void useOS(char const *objectFile)
+{
+        OSFile = objectFile;
+}
 
-                if (NULL != symbol) {
-                        strcat(buff, symbol->name);
-                } else {
-                        strcpy(buff, "NOP");
-                }
-                break;
-        case LEA:
-        case LD:
-        case LDI:
-        case ST:
-        case STI:
-                switch (opcode) {
-                case LEA:
-                        strcpy(buff, "LEA R");
-                        break;
-                case LD:
-                        strcpy(buff, "LD R");
-                        break;
-                case LDI:
-                        strcpy(buff, "LDI R");
-                        break;
-                case ST:
-                        strcpy(buff, "ST R");
-                        break;
-                case STI:
-                        strcpy(buff, "STI R");
-                        break;
-                default:
-                        break;
-                }
+/*
+ * Returns: The object file of the Operating System, or NULL for the built in
+ * one.
+ */
 
-                buff[strlen(buff)] = (char) (((instr >> 9) & 0x7) + 0x30);
-                strcat(buff, ", ");
-                if (instr & 0x0100) {
-                        offset = ((int16_t) (instr << 7)) >> 7;
-                        symbol = findSymbolByAddress((uint16_t) address +
-                                                     (uint16_t) offset);
-                } else {
-                        symbol = findSymbolByAddress((uint16_t) address +
-                                                     (uint16_t) (instr & 0x00FF));
-                }
+char const *customOS(void)
+{
+        return OSFile;
+}
 
-                if (NULL != symbol) {
-                        strcat(buff, symbol->name);
-                } else {
-                        strcpy(buff, "NOP");
-                }
-                break;
-        case LDR:
-        case STR:
-                strcpy(buff, STR == opcode ? "STR R" : "LDR R");
-                buff[5] = (char) ((instr >> 9 & 0x7) + 0x30);
-                strcat(buff, ", R");
-                buff[9] = (char) ((instr >> 6 & 0x7) + 0x30);
-                strcat(buff, ", #");
-                snprintf(immediate, 5, "%hd",
-                        (int16_t) ((int16_t) (instr << 10) << 10));
-                strcat(buff, immediate);
-                break;
-        case NOT:
-                strcpy(buff, "NOT R");
-                buff[5] = (char) ((instr >> 9 & 0x7) + 0x30);
-                strcat(buff, ", R");
-                buff[9] = (char) ((instr >> 6 & 0x7) + 0x30);
-                break;
-        case TRAP:
-                switch (instr & 0x00FF) {
-                case 0x25:
-                        strcpy(buff, "HALT");
-                        break;
-                case 0x24:
-                        strcpy(buff, "PUTSP");
-                        break;
-                case 0x23:
-                        strcpy(buff, "IN");
-                        break;
-                case 0x22:
-                        strcpy(buff, "PUTS");
-                        break;
-                case 0x21:
-                        strcpy(buff, "OUT");
-                        break;
-                case 0x20:
-                        strcpy(buff, "GETC");
-                        break;
-                default:
-                        strcpy(buff, "NOP");
-                        break;
+static void readOSImage(void)
+{
+        if (NULL != OSFile) {
+                // There's nothing to be done without an Operating System.
+                if (!readImage(OSFile, &OSImage)) {
+                        exit(EXIT_FAILURE);
                 }
-                break;
-        default:
-                break;
+        } else if (builtinOSLength) {
+                OSImage = (struct image) {
+                        .origin = builtinOS[0],
+                        .count  = builtinOSLength - 1,
+                        .words  = builtinOS,
+                };
         }
+}
 
-        return buff;
+/*
+ * Install the Operating System (really, just put it into memory).
+ */
+
+static void installOS(struct program *program)
+{
+        pthread_once(&OSImageRead, readOSImage);
+        loadImage(&program->simulator, &OSImage);
+
+        if (!program->OSInstalled) {
+                populateOSSymbols(program);
+                program->OSInstalled = true;
+        }
 }
 
-static void winPrint(WINDOW *window, struct program *program, size_t address,
-                     int y, int x)
+/*
+ * The program's symbols are only read in once something needs them.
+ */
+
+static void installSymbols(struct program *program)
 {
-        struct symbol *symbol = NULL;
-        char instr[100] = {0};
-        char label[100] = {0};
-
-        char binary[] = "0000000000000000";
-        for (int i = 15, bit = 1; i >= 0; i--, bit <<= 1) {
-                binary[i] =
-                        (char) (program->simulator.memory[address].value & bit ?
-                                '1' : '0');
+        if (!program->symbolsInstalled) {
+                populateSymbolsFromFile(program);
+                program->symbolsInstalled = true;
         }
+}
 
-        instruction(program->simulator.memory[address].value,
-                (uint16_t) (address + 1), instr, program);
+/*
+ * Read the program's object file into memory, along with the Operating System,
+ * leaving the image to say where it went.
+ */
 
-        symbol = findSymbolByAddress((uint16_t) address);
-        if (NULL != symbol) {
-                strcpy(label, symbol->name);
+static bool loadProgram(struct program *program, struct image *image)
+{
+        if (!readImage(program->objectfile, image)) {
+                return false;
         }
 
-        mvwprintw(window, y, x, FORMAT, address, binary,
-                program->simulator.memory[address].value, label, instr);
-        wrefresh(window);
+        installOS(program);
+        program->symbolsInstalled = false;
+
+        loadImage(&program->simulator, image);
+
+        free((void *) image->words);
+        image->words = NULL;
+
+        return true;
 }
 
-void update(WINDOW *window, struct program *program)
+/*
+ * Populate the memory of the supplied simulator with the contents of
+ * the provided file.
+ *
+ * @program: The program we want to populate the memory of, which also contains the
+ *           file we will read the memory from.
+ *
+ * Returns: 0 on success, >0 on failure.
+ */
+
+int populateMemory(struct program *program)
 {
-        memoryOutput[selected] = program->simulator.memory[selectedAddress].value;
-        wattron(window, SELECTED_ATTRIBUTES);
-        winPrint(window, program, selectedAddress, selected + 1, 1);
-        wattroff(window, SELECTED_ATTRIBUTES);
+        struct image image;
+
+        if (!loadProgram(program, &image)) {
+                return 1;
+        }
+
+        // First word in the .obj file is the starting PC.
+        program->simulator.PC = image.origin;
+
+        return 0;
 }
 
 /*
- * Redraw the memory view. Called after every time the user moves up / down in
- * the area.
+ * Load the program and write out a listing of memory from first to last (both
+ * included), or of just the program if first is negative.
+ *
+ * Returns: 0 on success, >0 if the program couldn't be loaded.
  */
 
-static void redraw(WINDOW *window, struct program *program)
+int listProgram(struct program *program, long first, long last, FILE *file)
 {
-        for (int i = 0; i < outputHeight; ++i) {
-                if (i < selected) {
-                        if (program->simulator.memory[selectedAddress - selected + i].isBreakpoint) {
-                                wattron(window, BREAKPOINT_ATTRIBUTES);
-                        }
-
-                        winPrint(window, program,
-                                (size_t) selectedAddress - (size_t) selected +
-                                (size_t) i, i + 1, 1);
-
-                        if (program->simulator.memory[selectedAddress - selected + i].isBreakpoint) {
-                                wattroff(window, BREAKPOINT_ATTRIBUTES);
-                        }
-                } else {
-                        if (program->simulator.memory[selectedAddress + i].isBreakpoint) {
-                                wattron(window, BREAKPOINT_ATTRIBUTES);
-                        }
-
-                        winPrint(window, program, (size_t) selectedAddress +
-                                                  (size_t) i, i + 1, 1);
-
-                        if (program->simulator.memory[selectedAddress + i].isBreakpoint) {
-                                wattroff(window, BREAKPOINT_ATTRIBUTES);
-                        }
+        struct image image;
+
+        if (!loadProgram(program, &image)) {
+                return 1;
+        }
+        installSymbols(program);
+
+        if (first < 0) {
+                if (!image.count) {
+                        return 0;
                 }
+
+                first = image.origin;
+                last = image.origin + (long) image.count - 1;
         }
 
-        wattron(window, SELECTED_ATTRIBUTES);
-        winPrint(window, program, selectedAddress, selected + 1, 1);
-        wattroff(window, SELECTED_ATTRIBUTES);
+        listMemory(program, (uint16_t) first, (uint16_t) last, file);
+
+        return 0;
 }
 
+/*
+ * Remember the machine as it is now (just loaded, presumably), so that
+ * resetMachine() can put it back this way.
+ */
+
+void snapshotMachine(struct program *program)
+{
+        if (NULL == program->pristine) {
+                program->pristine = malloc(sizeof(struct LC3));
+                if (NULL == program->pristine) {
+                        perror("LC3-Simulator");
+                        exit(EXIT_FAILURE);
+                }
+        }
+
+        memset(program->simulator.dirtyPages, 0,
+               sizeof(program->simulator.dirtyPages));
+        *program->pristine = program->simulator;
+}
 
 /*
- * Given a currently selected index and address, populate the memoryOutput
- * array to contain relative values.
+ * Put the machine back the way it was when snapshotMachine() was called,
+ * copying back only the pages of memory that have changed since.
  */
 
-void generateContext(WINDOW *window, struct program *program, int _selected,
-                     uint16_t _selectedAddress)
+void resetMachine(struct program *program)
 {
-        int i = 0;
+        struct LC3 *simulator = &program->simulator;
+        struct LC3 const *pristine = program->pristine;
 
-        selected = _selected;
-        selectedAddress = _selectedAddress;
+        // The device registers are written on every step, without going
+        // through writeMemory(), so their page is always put back.
+        markDirty(simulator, 0xFE00);
 
-        selected =
-                ((selectedAddress + (outputHeight - 1 - selected)) > 0xfffe) ?
-                (outputHeight - (0xfffe - selectedAddress)) - 1 : selected;
+        for (size_t i = 0; i < PAGES / 64; i++) {
+                for (uint64_t pages = simulator->dirtyPages[i]; pages;
+                     pages &= pages - 1) {
+                        size_t page = i * 64 + (size_t) __builtin_ctzll(pages);
 
-        for (; i < selected; i++)
-                memoryOutput[i] = program->simulator.memory[
-                        selectedAddress - selected + i].value;
-        for (; i < outputHeight; i++)
-                memoryOutput[i] = program->simulator.memory[
-                        selectedAddress + i].value;
+                        memcpy(&simulator->memory[page << PAGE_BITS],
+                               &pristine->memory[page << PAGE_BITS],
+                               sizeof(struct memorySlot) << PAGE_BITS);
+                }
+        }
 
-        redraw(window, program);
-        memPopulated = selectedAddress;
+        // Everything else (registers, flags, and the clean dirty pages) is
+        // ahead of memory.
+        memcpy(simulator, pristine, offsetof(struct LC3, memory));
 }
 
-void moveContext(WINDOW *window, struct program *program, enum DIRECTION direction)
+/*
+ * Disassemble the word stored at the given address, as it would be shown in
+ * the memory view.
+ */
+
+char *disassemble(struct program *program, uint16_t address, char *buff)
 {
-        bool _redraw = false;
-        int prev = selected;
-        uint16_t previousAddress = selectedAddress;
-
-        switch (direction) {
-        case UP:
-                selectedAddress -= selectedAddress != 0;
-                selected = !selected ? _redraw = true, 0 : selected - 1;
-                break;
-        case DOWN:
-                selectedAddress += (0xFFFE == selectedAddress) ? 0 : 1;
-                selected = ((outputHeight - 1) == selected) ? _redraw = true,
-                        (outputHeight - 1) : selected + 1;
-                break;
-        default:
-                break;
+        installSymbols(program);
+
+        return disassembleWord(program, program->simulator.memory[address].value,
+                address, buff, DISASSEMBLY_LENGTH);
+}
+
+/*
+ * The row of the memory view for the given word at the given address: the
+ * address, the word in binary and hex, its label, and the word disassembled.
+ * The word is passed in, rather than read from memory, as a running machine's
+ * memory is only seen through its snapshots. Rows are only worked out again
+ * once the word or the symbols change, so redrawing the view is mostly just
+ * looking them up.
+ */
+
+char const *memoryRow(struct program *program, uint16_t address,
+                      uint16_t value)
+{
+        struct memoryRow **page;
+        struct memoryRow *row;
+        struct symbol *symbol;
+        char binary[17];
+        char instr[DISASSEMBLY_LENGTH];
+
+        installSymbols(program);
+
+        if (NULL == program->rows) {
+                program->rows = calloc(1, sizeof(struct memoryRows));
+                if (NULL == program->rows) {
+                        perror("LC3-Simulator");
+                        exit(EXIT_FAILURE);
+                }
         }
 
-        wattron(window, SELECTED_ATTRIBUTES);
-        winPrint(window, program, selectedAddress, selected + 1, 1);
-        wattroff(window, SELECTED_ATTRIBUTES);
+        page = &program->rows->pages[address >> PAGE_BITS];
+        if (NULL == *page) {
+                *page = calloc(ROWS_PER_PAGE, sizeof(struct memoryRow));
+                if (NULL == *page) {
+                        perror("LC3-Simulator");
+                        exit(EXIT_FAILURE);
+                }
+        }
 
-        if (program->simulator.memory[previousAddress].isBreakpoint) {
-                wattron(window, BREAKPOINT_ATTRIBUTES);
+        row = &(*page)[address & (ROWS_PER_PAGE - 1)];
+        if ('\0' != row->text[0] && value == row->value &&
+            program->symbols.generation == row->generation) {
+                return row->text;
         }
 
-        winPrint(window, program, previousAddress, prev + 1, 1);
+        memcpy(binary,      binaryDigits[value >> 12], 4);
+        memcpy(binary + 4,  binaryDigits[value >> 8 & 0xf], 4);
+        memcpy(binary + 8,  binaryDigits[value >> 4 & 0xf], 4);
+        memcpy(binary + 12, binaryDigits[value & 0xf], 4);
+        binary[16] = '\0';
+
+        disassembleWord(program, value, address, instr, sizeof(instr));
+        symbol = findSymbolByAddress(program, address);
 
-        if (program->simulator.memory[previousAddress].isBreakpoint) {
-                wattroff(window, BREAKPOINT_ATTRIBUTES);
+        snprintf(row->text, ROW_LENGTH, ROW_FORMAT, address, binary, value,
+                NULL != symbol ? symbol->name : "", instr);
+        row->value = value;
+        row->generation = program->symbols.generation;
+
+        return row->text;
+}
+
+void freeRows(struct program *program)
+{
+        if (NULL == program->rows) {
+                return;
         }
 
-        if (_redraw) {
-                generateContext(window, program, selected, selectedAddress);
+        for (size_t i = 0; i < PAGES; i++) {
+                free(program->rows->pages[i]);
         }
-}
 
+        free(program->rows);
+        program->rows = NULL;
+}
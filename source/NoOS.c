@@ -0,0 +1,12 @@
+#include "OS.h"
+
+/*
+ * No Operating System at all, for the assembler that assembles the real one
+ * while we're being built.
+ */
+
+uint16_t const builtinOS[1] = { 0 };
+size_t const builtinOSLength = 0;
+
+struct OSSymbol const builtinOSSymbols[1] = { { "", 0 } };
+size_t const builtinOSSymbolCount = 0;
@@ -1,16 +1,26 @@
+#ifdef __linux__
+#define _XOPEN_SOURCE 700
+#endif
+
 #include <string.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <limits.h>
 #include <ctype.h>
-
+#include <pthread.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "Memory.h"
+#include "OS.h"
 #include "Parser.h"
+#include "Scan.h"
 #include "Token.h"
 
-#ifndef OS_PATH
-#error "No Path has been supplied for the Operating System."
-#endif
-
 // TODO:
 //      - For Machine.c:
 //              - If the symbol file can't be found, then show the user a warning,
@@ -49,440 +59,1134 @@
 //              This allows modularisation as well as being able to more easily spread out
 //              the logic into 2 projects (an assembler and a simulator)
 //              This would agree with the idea to rewrite this in C++ (for strings, getline).
-//	- Move the OS code to be builtin (?)
-//		- What if someone wants to explicitly alter it -- without using instructions.
 //
 
-#define STR(x) #x
-#define OSPATH(path) STR(path)
-#define OS_SYM_FILE OSPATH(OS_PATH) "/LC3_OS.sym"
+// These report to parse()'s err, which is where the program wants to be told
+// about problems.
+#define ERROR(str, ...)   fprintf(err, "ERROR: "   str ".\n", __VA_ARGS__)
+#define WARNING(str, ...) fprintf(err, "WARNING: " str ".\n", __VA_ARGS__)
+#define NOTE(str, ...)    fprintf(err, "NOTE: "    str ".\n", __VA_ARGS__)
+
+/*
+ * The file being assembled. It is read in one go (mapped, where we can) and
+ * lexed straight out of memory.
+ */
+
+struct source
+{
+	char *data;
+	char const *at;
+	char const *end;
+	size_t size;
+	bool mapped;
+};
 
-#define ERROR(str, ...)   fprintf(stderr, "ERROR: "   str ".\n", __VA_ARGS__)
-#define WARNING(str, ...) fprintf(stderr, "WARNING: " str ".\n", __VA_ARGS__)
-#define NOTE(str, ...)    fprintf(stderr, "NOTE: "    str ".\n", __VA_ARGS__)
+/*
+ * A token, or any other piece of the source. Nothing is copied out of the
+ * source unless it has to outlive it, so there is no limit on how long a
+ * label (or anything else) can be.
+ */
 
-// This will have to do for now... It allows the use of '//' as a comment.
-static char lastSkippedChar = 0;
+struct slice
+{
+	char const *text;
+	int length;
+};
 
-#define MAX_LABEL_LENGTH 80
+// For printing a slice with "%.*s".
+#define SLICE(slice) (slice).length, (slice).text
 
 /*
- * Copy the contents of one string to another, allocating enough memory to the
- * string we want to copy to.
+ * Read the whole of the given file into memory.
+ *
+ * Returns: false if the file couldn't be read, with errno set.
  */
 
-static void strmcpy(char **to, char const *from)
+static bool openSource(char const *fileName, struct source *source)
 {
-	size_t len = strlen(from) + 1;
+	struct stat status;
+	int fd = open(fileName, O_RDONLY);
 
-	*to = malloc(sizeof(char) * len);
-	if (NULL == *to) {
-		perror("LC3-Simulator");
-		exit(EXIT_FAILURE);
+	*source = (struct source) { .data = NULL };
+
+	if (-1 == fd) {
+		return false;
 	}
 
-	strncpy(*to, from, len);
-}
+	if (-1 != fstat(fd, &status) && S_ISREG(status.st_mode) &&
+	    status.st_size > 0) {
+		void *data = mmap(NULL, (size_t) status.st_size, PROT_READ,
+				  MAP_PRIVATE, fd, 0);
+		if (MAP_FAILED != data) {
+			source->data = data;
+			source->size = (size_t) status.st_size;
+			source->mapped = true;
+		}
+	}
 
-/*
- * Skip all whitespace characters in a file. If a new line is reached, return
- * early so that the caller can handle it.
- */
+	// Not something that can be mapped (or empty), so just read it.
+	if (!source->mapped) {
+		size_t capacity = 0;
+		ssize_t got = 0;
+
+		do {
+			source->size += (size_t) got;
+			if (source->size == capacity) {
+				capacity = capacity ? capacity * 2 : 4096;
+				source->data = realloc(source->data, capacity);
+				if (NULL == source->data) {
+					perror("LC3-Simulator");
+					exit(EXIT_FAILURE);
+				}
+			}
+		} while (0 < (got = read(fd, source->data + source->size,
+					 capacity - source->size)));
+
+		if (-1 == got) {
+			int error = errno;
+			free(source->data);
+			close(fd);
+			errno = error;
+			return false;
+		}
+	}
+
+	close(fd);
+
+	source->at = source->data;
+	source->end = source->data + source->size;
 
-static void skipWhitespace(FILE *file)
+	return true;
+}
+
+static void closeSource(struct source *source)
 {
-	int c = 0;
-	while (EOF != (c = fgetc(file)) && isspace(c)) {
-		if ('\n' == c) {
-                        break;
-                }
+	if (source->mapped) {
+		munmap(source->data, source->size);
+	} else {
+		free(source->data);
 	}
 
-	ungetc(c, file);
-	lastSkippedChar = (char) c;
+	*source = (struct source) { .data = NULL };
 }
 
 /*
- * Go to the next line of the file.
+ * Take the next character from the source, just like fgetc().
  */
 
-static void nextLine(FILE *file)
+static int nextChar(struct source *source)
 {
-	int c = 0;
-	while ('\n' != (c = fgetc(file)) && EOF != c)
-		/* NO OP */;
-
-	ungetc(c, file);
+	return source->at < source->end ? (unsigned char) *source->at++ : EOF;
 }
 
-static struct symbolTable *tableTail;
-struct symbolTable tableHead = {
-	.sym = NULL,
-	.next = NULL,
-};
+/*
+ * Put back the character we just took, just like ungetc().
+ */
 
-struct list
+static void putBack(struct source *source, int c)
 {
-	uint16_t instruction;
-	struct list *next;
-};
+	if (EOF != c) {
+		source->at--;
+	}
+}
 
-struct list *listTail;
-struct list listHead = {
-	.instruction = 0,
-	.next = NULL,
-};
+/*
+ * Copy a slice out of the source, so that it can be kept.
+ */
 
-static void insert(uint16_t instruction)
+static char *copySlice(struct slice slice)
 {
-	struct list *list = malloc(sizeof(struct list));
-	if (NULL == list) {
+	char *copy = malloc((size_t) slice.length + 1);
+	if (NULL == copy) {
 		perror("LC3-Simulator");
 		exit(EXIT_FAILURE);
 	}
 
-	list->instruction = instruction;
-	list->next = NULL;
+	memcpy(copy, slice.text, (size_t) slice.length);
+	copy[slice.length] = '\0';
 
-	if (NULL == listHead.next) {
-		listHead.next = list;
-	} else {
-		listTail->next = list;
-	}
-
-	listTail = list;
+	return copy;
 }
 
-static void __freeList(struct list *list)
+/*
+ * The value of a digit, in any base up to 16.
+ *
+ * Returns: The digit's value, or 16 if it isn't a digit at all.
+ */
+
+static int digitValue(int c)
 {
-	if (NULL != list->next) {
-		__freeList(list->next);
-		free(list->next);
+	if (isdigit(c)) {
+		return c - '0';
+	} else if (isxdigit(c)) {
+		return toupper(c) - 'A' + 10;
 	}
+
+	return 16;
 }
 
-static void freeList(struct list *list)
+/*
+ * Skip all whitespace characters in the source. If a new line is reached,
+ * return early so that the caller can handle it.
+ *
+ * Returns: The character after the whitespace, which is left in the source.
+ */
+
+static int skipWhitespace(struct source *source)
 {
-	__freeList(list);
+	source->at = skipBlanks(source->at, source->end);
 
-	if (NULL != listTail) {
-		listTail = NULL;
-	}
+	return source->at < source->end ? (unsigned char) *source->at : EOF;
 }
 
-static void __freeTable(struct symbolTable *table)
-{
-	if (NULL != table->next) {
-		__freeTable(table->next);
-		free(table->next);
-	}
+/*
+ * Go to the next line of the source.
+ */
 
-	if (NULL != table->sym) {
-		free(table->sym->name);
-		free(table->sym);
-	}
+static void nextLine(struct source *source)
+{
+	source->at = findNewline(source->at, source->end);
 }
 
-void freeTable(struct symbolTable *table)
+/*
+ * Take the next word (anything up to whitespace) from the source, skipping
+ * any whitespace, new lines included, before it.
+ */
+
+static struct slice nextWord(struct source *source)
 {
-	__freeTable(table);
+	struct slice word;
 
-	if (NULL != tableTail) {
-		tableTail = NULL;
+	while (source->at < source->end && isspace((unsigned char) *source->at)) {
+		source->at++;
 	}
+
+	word.text = source->at;
+	source->at = findSpace(source->at, source->end);
+	word.length = (int) (source->at - word.text);
+
+	return word;
 }
 
 /*
- * Add a symbol by name. This isn't exactly optimal, but without hashing/maps
- * this is probably the easier way to do it. It also allows us to easily look up
- * an address in order.
+ * The words of the object file: the origin, and then each word of the program
+ * in turn, laid out just as they'll be in memory.
  */
-static struct symbol *findSymbol(char const *const name)
+
+struct image
 {
-	struct symbolTable *symTable = tableHead.next;
+	size_t count;
+	int overflow;           // The line that first ran out of memory.
+	uint16_t words[0x10001];
+};
+
+/*
+ * Add a word to the end of the image, unless the program has already filled
+ * every address there is.
+ */
 
-	while (NULL != symTable) {
-		if (!strcmp(symTable->sym->name, name)) {
-			return symTable->sym;
+static void emit(struct image *image, uint16_t word, int line)
+{
+	if (image->count == sizeof(image->words) / sizeof(uint16_t)) {
+		if (!image->overflow) {
+			image->overflow = line;
 		}
-		symTable = symTable->next;
+		return;
 	}
 
-	return NULL;
+	image->words[image->count++] = word;
 }
 
 /*
- * Find out whether there exists a symbol at a specific address.
- *
- * As each symbol is added to the table in order, we can quit early if the
- * address of the current symbol is greater than the address we're looking for.
+ * A block of storage for symbols and their names, which are handed out from
+ * the front of it in turn.
  */
-struct symbol *findSymbolByAddress(uint16_t address)
+
+struct symbolBlock
 {
-	struct symbolTable *symTable = tableHead.next;
+	struct symbolBlock *next;
+	size_t used, size;
+	char data[];
+};
 
-	while (NULL != symTable) {
-		if (NULL == symTable->sym) {
-			return NULL;
-		}
-		if (symTable->sym->address == address) {
-			return symTable->sym;
-		} else if (symTable->sym->address > address) {
-			return NULL;
-		}
-		symTable = symTable->next;
-	}
+// The usual size of a block, which only a very long name would need more of.
+#define SYMBOL_BLOCK_SIZE (64 * 1024)
 
-	return NULL;
-}
+/*
+ * A symbol cache that's been loaded, whose names the symbols point into, so
+ * it's kept (mapped) until the symbols are freed.
+ */
 
-static void __addSymbol(char const *const name, uint16_t address, int line)
+struct symbolCache
 {
-	struct symbol *symbol = malloc(sizeof(struct symbol));
+	struct symbolCache *next;
+	struct source source;
+};
 
-	if (NULL == symbol) {
-		perror("LC3-Simulator");
-		exit(EXIT_FAILURE);
-	}
+/*
+ * The binary form of a symbol file, which is written beside the text one:
+ * this header, then an entry for each symbol (in the same order as the text
+ * file), then all of their names, one after the other.
+ */
 
-        struct symbolTable *table;
-	table = malloc(sizeof(struct symbolTable));
+#define SYMBOL_CACHE_MAGIC   "LC3S"
+#define SYMBOL_CACHE_VERSION 1
 
-	if (NULL == table) {
-		perror("LC3-Simulator");
-		exit(EXIT_FAILURE);
-	}
+struct cacheHeader
+{
+	char magic[4];
+	uint32_t version;       // Which also tells us it's in our byte order.
+	uint32_t count;
+	uint32_t poolSize;
+};
 
-        strmcpy(&symbol->name, name);
-        symbol->address = address;
-        symbol->fromOS = false;
-        symbol->line = line;
+struct cacheEntry
+{
+	uint32_t name;          // Where the name starts in the pool.
+	uint32_t hash;
+	uint16_t address;
+	uint16_t unused;
+};
+
+/*
+ * Free every symbol the program knows of, so that they can be reloaded.
+ */
 
-	table->sym = symbol;
-	table->next = NULL;
+void freeTable(struct program *program)
+{
+	struct symbolTable *table = &program->symbols;
+	struct symbolBlock *next;
+	struct symbolCache *nextCache;
+
+	for (struct symbolBlock *block = table->blocks; NULL != block;
+	     block = next) {
+		next = block->next;
+		free(block);
+	}
 
-	if (NULL == tableHead.next) {
-		tableHead.next = table;
-	} else {
-		tableTail->next = table;
+	for (struct symbolCache *cache = table->caches; NULL != cache;
+	     cache = nextCache) {
+		nextCache = cache->next;
+		closeSource(&cache->source);
+		free(cache);
 	}
 
-	tableTail = table;
+	free(table->symbols);
+	free(table->slots);
+	free(table->byAddress);
+	*table = (struct symbolTable) {
+		.generation = table->generation + 1,
+	};
+
+	program->OSInstalled = false;
+	program->symbolsInstalled = false;
 }
 
 /*
- * Add a Symbol by name and address into the Symbol Table.
+ * The FNV-1a hash of a symbol's name.
  */
 
-static int addSymbol(char const *const name, uint16_t address, int line)
+static uint32_t hashName(struct slice name)
 {
-	if (NULL != findSymbol(name)) {
-                return 1;
-        }
+	uint32_t hash = 2166136261u;
 
-        __addSymbol(name, address, line);
-	return 0;
+	for (int i = 0; i < name.length; i++) {
+		hash = (hash ^ (unsigned char) name.text[i]) * 16777619u;
+	}
+
+	return hash;
 }
 
-static void populateSymbols(char *fileName)
+/*
+ * Find the slot the named symbol is in, or the empty slot it would go in.
+ */
+
+static struct symbol **findSlot(struct symbolTable const *table,
+				struct slice name, uint32_t hash)
 {
-	FILE *file = fopen(fileName, "r");
-	if (NULL == file) {
-		perror("LC3Simulator");
-		exit(EXIT_FAILURE);
-	}
+	size_t mask = table->slotCount - 1;
+	struct symbol **slot;
 
-	uint16_t address;
-	char label[MAX_LABEL_LENGTH];
-	char beginning[3] = { 0 };
-	int c = 0;
+	for (size_t i = hash & mask; ; i = (i + 1) & mask) {
+		slot = &table->slots[i];
 
-	for (size_t i = 4; i > 0; i--) {
-		nextLine(file);
-		c = fgetc(file);
+		if (NULL == *slot || ((*slot)->hash == hash &&
+		    !strncmp((*slot)->name, name.text, (size_t) name.length) &&
+		    '\0' == (*slot)->name[name.length])) {
+			return slot;
+		}
 	}
+}
 
-	ungetc(c, file);
+static struct symbol *lookup(struct program const *program, struct slice name)
+{
+	struct symbolTable const *table = &program->symbols;
 
-	while (EOF != fscanf(file, "%s %s %hx", beginning, label, &address)) {
-                __addSymbol(label, address, 0);
-		memset(label, 0, MAX_LABEL_LENGTH);
+	if (!table->count) {
+		return NULL;
 	}
 
-	fclose(file);
+	return *findSlot(table, name, hashName(name));
 }
 
-void populateOSSymbols(void)
+struct symbol *findSymbol(struct program const *program,
+			  char const *const name)
 {
-	populateSymbols((char *) OS_SYM_FILE);
-	// For now this will serve as a way of being able to tell whether
-	// something is a part of the Operating System, or from the User's
-	// program.
-	for (struct symbolTable *table = tableHead.next; NULL != table;
-			table = table->next) {
-		table->sym->fromOS = true;
-	}
+	return lookup(program, (struct slice) { name, (int) strlen(name) });
 }
 
 /*
- * If started up without assembling before hand, the program won't be aware
- * of the symbols in the file that will be needed in the output of the program
- * in memory.
+ * Find the first symbol at a specific address. Any others there follow on from
+ * it, through sameAddress.
  */
-
-void populateSymbolsFromFile(struct program *program)
+struct symbol *findSymbolByAddress(struct program const *program,
+				   uint16_t address)
 {
-	if (NULL == program->symbolfile) {
-		char *ext = strrchr(program->objectfile, '.');
-		size_t length = strlen(program->objectfile);
+	struct symbolTable const *table = &program->symbols;
 
-		if (NULL != ext) {
-			program->symbolfile = calloc(length + 1, sizeof(char));
-			if (NULL == program->symbolfile) {
-				perror("LC3-Simulator");
-				exit(EXIT_FAILURE);
-			}
+	return NULL != table->byAddress ? table->byAddress[address] : NULL;
+}
 
-			strncpy(program->symbolfile, program->objectfile,
-				(size_t) (ext - program->objectfile));
-		} else {
-			program->symbolfile = calloc(length + 5, sizeof(char));
-			if (NULL == program->symbolfile) {
-				perror("LC3-Simulator");
-				exit(EXIT_FAILURE);
-			}
+/*
+ * Make room for a symbol with a name of the given length.
+ */
+
+static struct symbol *newSymbol(struct symbolTable *table, size_t length)
+{
+	// Keep every symbol aligned as well as the pointer at its start.
+	size_t size = (sizeof(struct symbol) + length + sizeof(char *) - 1) &
+		      ~(sizeof(char *) - 1);
+	struct symbolBlock *block = table->blocks;
 
-			strcpy(program->symbolfile, program->objectfile);
+	if (NULL == block || block->size - block->used < size) {
+		size_t blockSize = size > SYMBOL_BLOCK_SIZE ? size :
+				   SYMBOL_BLOCK_SIZE;
+
+		block = malloc(sizeof(struct symbolBlock) + blockSize);
+		if (NULL == block) {
+			perror("LC3-Simulator");
+			exit(EXIT_FAILURE);
 		}
 
-		strcat(program->symbolfile, ".sym");
+		block->next = table->blocks;
+		block->used = 0;
+		block->size = blockSize;
+		table->blocks = block;
 	}
 
-	populateSymbols(program->symbolfile);
+	struct symbol *symbol = (struct symbol *) (block->data + block->used);
+	block->used += size;
+
+	return symbol;
 }
 
 /*
- * Copy one string to another character by character, converting them to
- * upper case as we go.
+ * Double the number of slots in the hash table, and put every symbol back in
+ * its new place.
  */
 
-static void copy_upper(char *const from, char *to)
+static void growSlots(struct symbolTable *table)
 {
-        for (char *i = from; *i; ++i) {
-                *to = (char) toupper(*i);
-                to++;
-        }
+	free(table->slots);
+
+	table->slotCount = table->slotCount ? table->slotCount * 2 : 256;
+	table->slots = calloc(table->slotCount, sizeof(struct symbol *));
+	if (NULL == table->slots) {
+		perror("LC3-Simulator");
+		exit(EXIT_FAILURE);
+	}
+
+	for (size_t i = 0; i < table->count; i++) {
+		struct symbol *symbol = table->symbols[i];
+		struct slice name = { symbol->name, (int) strlen(symbol->name) };
+		struct symbol **slot = findSlot(table, name, symbol->hash);
+
+		if (NULL == *slot) {
+			*slot = symbol;
+		}
+	}
 }
 
 /*
- * Convert every character in a string to uppercase, and compare it against the
- * provided string.
+ * Make sure there's room in the table for this many more symbols.
  */
 
-static int uppercmp(char *from, char const *const to)
+static void reserveSymbols(struct symbolTable *table, size_t count)
 {
-	char copy[100] = { 0 };
-	copy_upper(from, copy);
-	return strcmp(copy, to);
+	if (table->count + count > table->capacity) {
+		while (table->count + count > table->capacity) {
+			table->capacity = table->capacity ?
+					  table->capacity * 2 : 256;
+		}
+
+		table->symbols = realloc(table->symbols,
+				table->capacity * sizeof(struct symbol *));
+		if (NULL == table->symbols) {
+			perror("LC3-Simulator");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	while (2 * (table->count + count) > table->slotCount) {
+		growSlots(table);
+	}
+
+	if (NULL == table->byAddress) {
+		table->byAddress = calloc(0x10000, sizeof(struct symbol *));
+		if (NULL == table->byAddress) {
+			perror("LC3-Simulator");
+			exit(EXIT_FAILURE);
+		}
+	}
 }
 
 /*
- * Retrieve the hex form of the conditions supplied by the BR instruction.
+ * Put a symbol, with everything but sameAddress filled in, into the table,
+ * which must already have room for it. If there's already a symbol by that
+ * name, the first one added is still the one that gets found.
  */
 
-static uint16_t nzp(char const *const _nzp)
+static void insertSymbol(struct symbolTable *table, struct symbol *symbol)
 {
-	uint16_t __nzp = 0;
+	struct slice name = { symbol->name, (int) strlen(symbol->name) };
 
-	for (size_t i = 0; _nzp[i]; i++) {
-		if ('N' == toupper(_nzp[i])) {
-			__nzp |= 0x0800;
-		} else if ('Z' == toupper(_nzp[i])) {
-			__nzp |= 0x0400;
-		} else if ('P' == toupper(_nzp[i])) {
-			__nzp |= 0x0200;
-		} else {
-			return 0x1;
-		}
+	symbol->sameAddress = NULL;
+	table->symbols[table->count++] = symbol;
+	table->generation++;
+
+	struct symbol **last = &table->byAddress[symbol->address];
+	while (NULL != *last) {
+		last = &(*last)->sameAddress;
 	}
+	*last = symbol;
 
-	return (uint16_t) (__nzp ? __nzp : 0x0e00);
+	struct symbol **slot = findSlot(table, name, symbol->hash);
+	if (NULL == *slot) {
+		*slot = symbol;
+	}
+}
+
+/*
+ * Add a symbol to the table, whether or not there's already one by that name.
+ */
+
+static struct symbol *__addSymbol(struct program *program, struct slice name,
+				  uint16_t address, int line)
+{
+	struct symbolTable *table = &program->symbols;
+
+	reserveSymbols(table, 1);
+
+	struct symbol *symbol = newSymbol(table, (size_t) name.length + 1);
+
+	symbol->name = (char *) (symbol + 1);
+	memcpy(symbol->name, name.text, (size_t) name.length);
+	symbol->name[name.length] = '\0';
+	symbol->hash = hashName(name);
+        symbol->address = address;
+        symbol->fromOS = false;
+        symbol->line = line;
+
+	insertSymbol(table, symbol);
+
+	return symbol;
 }
 
-static void objWrite(uint16_t *instruction, FILE *objFile)
+/*
+ * Add a Symbol by name and address into the Symbol Table.
+ */
+
+static int addSymbol(struct program *program, struct slice name,
+		     uint16_t address, int line)
 {
-	unsigned char bytes[2];
-	bytes[0] = (unsigned char) ((*instruction & 0xff00) >> 8);
-	bytes[1] = (unsigned char) (*instruction & 0xff);
-	fwrite(bytes, 2, 1, objFile);
+	if (NULL != lookup(program, name)) {
+                return 1;
+        }
+
+        __addSymbol(program, name, address, line);
+	return 0;
 }
 
-static void binWrite(uint16_t *instruction, FILE *binFile)
+/*
+ * Open a symbol file, skipping past its header to the first symbol.
+ */
+
+static void openSymbols(char const *fileName, struct source *source)
 {
-	char binary[] = "0000000000000000";
-	for (int i = 15, bit = 1; i >= 0; i--, bit <<= 1) {
-		binary[i] = (char) (*instruction & bit ? '1' : '0');
+	if (!openSource(fileName, source)) {
+		perror("LC3Simulator");
+		exit(EXIT_FAILURE);
 	}
 
-	fprintf(binFile, "%s\n", binary);
+	for (size_t i = 4; i > 0; i--) {
+		nextLine(source);
+		nextChar(source);
+	}
 }
 
-static void hexWrite(uint16_t *instruction, FILE *hexFile)
+/*
+ * Read the next symbol from a symbol file, which are listed as:
+ * 	//	NAME               ADDRESS
+ *
+ * Returns: false once there are no more symbols.
+ */
+
+static bool nextSymbol(struct source *source, struct slice *name,
+		       uint16_t *address)
 {
-	fprintf(hexFile, "%04X\n", *instruction);
+	nextWord(source);
+	*name = nextWord(source);
+
+	struct slice word = nextWord(source);
+	if (!word.length) {
+		return false;
+	}
+
+	*address = 0;
+	for (int i = 0; i < word.length && digitValue((unsigned char) word.text[i]) < 16; i++) {
+		*address = (uint16_t) (*address << 4 | digitValue((unsigned char) word.text[i]));
+	}
+
+	return true;
 }
 
-static void symWrite(struct symbol *symbol, FILE *symFile)
+/*
+ * The name of the symbol cache that goes with a symbol file.
+ */
+
+static char *cacheFileFor(char const *symbolFile)
 {
-	fprintf(symFile, "//\t%-18s %04X\n", symbol->name, symbol->address);
+	size_t length = strlen(symbolFile);
+
+	char *cacheFile = malloc(length + 2);
+	if (NULL == cacheFile) {
+		perror("LC3-Simulator");
+		exit(EXIT_FAILURE);
+	}
+
+	memcpy(cacheFile, symbolFile, length);
+	memcpy(cacheFile + length, "c", 2);
+
+	return cacheFile;
 }
 
 /*
- * Check whether the next token is a comment.
+ * Whether the file at the first path was last changed before the second.
  */
 
-static bool iscomment(FILE *file)
+static bool olderThan(char const *first, char const *second)
 {
-	int c = fgetc(file);
+	struct stat firstStatus, secondStatus;
 
-	if (';' == c) {
-		return true;
-	} else if ('/' == c) {
-		c = fgetc(file);
-		if ('/' == c) {
-			return true;
-		}
-		ungetc(c, file);
+	if (-1 == stat(first, &firstStatus) || -1 == stat(second, &secondStatus)) {
+		return false;
 	}
 
-	ungetc(c, file);
-	return false;
+	return firstStatus.st_mtim.tv_sec < secondStatus.st_mtim.tv_sec ||
+	       (firstStatus.st_mtim.tv_sec == secondStatus.st_mtim.tv_sec &&
+		firstStatus.st_mtim.tv_nsec < secondStatus.st_mtim.tv_nsec);
 }
 
 /*
- * Check whether we have reached the end of the line.
+ * Load the symbols from the cache beside a symbol file, if there is one that's
+ * up to date. The cache is mapped and used where it is: the names are never
+ * copied, and the hashes never worked out again.
+ *
+ * Returns: false if there was no cache we could use.
  */
 
-static bool endOfLine(FILE *file)
+static bool populateSymbolsFromCache(struct program *program,
+				     char const *fileName)
 {
-	int c;
-	skipWhitespace(file);
+	struct symbolTable *table = &program->symbols;
+	char *cacheName = cacheFileFor(fileName);
+	struct source source;
+	struct cacheHeader header;
+
+	if (olderThan(cacheName, fileName) || !openSource(cacheName, &source)) {
+		free(cacheName);
+		return false;
+	}
+	free(cacheName);
+
+	if (source.size < sizeof(header)) {
+		closeSource(&source);
+		return false;
+	}
+
+	memcpy(&header, source.data, sizeof(header));
+
+	struct cacheEntry const *entries =
+		(struct cacheEntry const *) (source.data + sizeof(header));
+	char const *pool = (char const *) (entries + header.count);
+
+	// Anything that doesn't add up is left for the text file to sort out.
+	if (memcmp(header.magic, SYMBOL_CACHE_MAGIC, sizeof(header.magic)) ||
+	    SYMBOL_CACHE_VERSION != header.version ||
+	    (source.size - sizeof(header)) / sizeof(struct cacheEntry) <
+	    header.count || source.size - sizeof(header) -
+	    header.count * sizeof(struct cacheEntry) != header.poolSize ||
+	    (header.poolSize && '\0' != pool[header.poolSize - 1])) {
+		closeSource(&source);
+		return false;
+	}
 
-	c = fgetc(file);
-	if ('\n' != c && EOF != c) {
-		ungetc(c, file);
-		if (!iscomment(file)) {
+	for (uint32_t i = 0; i < header.count; i++) {
+		if (entries[i].name >= header.poolSize) {
+			closeSource(&source);
 			return false;
 		}
 	}
 
-	ungetc(c, file);
-	return true;
-}
+	reserveSymbols(table, header.count);
 
-static const size_t hashed_letters[26] = {
-        100363, 99989, 97711, 97151, 92311, 80147,
-        82279,  72997, 66457, 65719, 70957, 50262,
+	for (uint32_t i = 0; i < header.count; i++) {
+		struct symbol *symbol = newSymbol(table, 0);
+
+		*symbol = (struct symbol) {
+			.name = (char *) pool + entries[i].name,
+			.hash = entries[i].hash,
+			.address = entries[i].address,
+		};
+		insertSymbol(table, symbol);
+	}
+
+	struct symbolCache *cache = malloc(sizeof(struct symbolCache));
+	if (NULL == cache) {
+		perror("LC3-Simulator");
+		exit(EXIT_FAILURE);
+	}
+
+	cache->source = source;
+	cache->next = table->caches;
+	table->caches = cache;
+
+	return true;
+}
+
+static void populateSymbols(struct program *program, char *fileName)
+{
+	struct source source;
+	struct slice label;
+	uint16_t address;
+
+	if (populateSymbolsFromCache(program, fileName)) {
+		return;
+	}
+
+	openSymbols(fileName, &source);
+
+	while (nextSymbol(&source, &label, &address)) {
+                __addSymbol(program, label, address, 0);
+	}
+
+	closeSource(&source);
+}
+
+/*
+ * The name of the symbol file that goes with an object file.
+ */
+
+static char *symbolFileFor(char const *objectFile)
+{
+	char const *ext = strrchr(objectFile, '.');
+	size_t length = NULL != ext ? (size_t) (ext - objectFile) :
+				      strlen(objectFile);
+
+	char *symbolFile = calloc(length + 5, sizeof(char));
+	if (NULL == symbolFile) {
+		perror("LC3-Simulator");
+		exit(EXIT_FAILURE);
+	}
+
+	memcpy(symbolFile, objectFile, length);
+	strcat(symbolFile, ".sym");
+
+	return symbolFile;
+}
+
+/*
+ * The Operating System's symbols never change, so if they have to be read
+ * from a file they are only read once, no matter how many programs (or
+ * threads) ask for them.
+ */
+
+static struct OSSymbol *OSSymbols = NULL;
+static size_t OSSymbolCount = 0;
+static pthread_once_t OSSymbolsRead = PTHREAD_ONCE_INIT;
+
+static void readOSSymbols(void)
+{
+	struct source source;
+	struct slice label;
+	size_t capacity = 0;
+	uint16_t address;
+
+	if (NULL == customOS()) {
+		return;
+	}
+
+	char *fileName = symbolFileFor(customOS());
+	openSymbols(fileName, &source);
+	free(fileName);
+
+	while (nextSymbol(&source, &label, &address)) {
+		if (OSSymbolCount == capacity) {
+			capacity = capacity ? capacity * 2 : 64;
+			OSSymbols = realloc(OSSymbols,
+					    capacity * sizeof(struct OSSymbol));
+			if (NULL == OSSymbols) {
+				perror("LC3-Simulator");
+				exit(EXIT_FAILURE);
+			}
+		}
+
+		OSSymbols[OSSymbolCount++] = (struct OSSymbol) {
+			.name = copySlice(label),
+			.address = address,
+		};
+	}
+
+	closeSource(&source);
+}
+
+void populateOSSymbols(struct program *program)
+{
+	struct OSSymbol const *symbols = builtinOSSymbols;
+	size_t count = builtinOSSymbolCount;
+
+	pthread_once(&OSSymbolsRead, readOSSymbols);
+	if (NULL != customOS()) {
+		symbols = OSSymbols;
+		count = OSSymbolCount;
+	}
+
+	for (size_t i = 0; i < count; ++i) {
+		struct slice name = {
+			symbols[i].name, (int) strlen(symbols[i].name)
+		};
+
+		// For now this will serve as a way of being able to tell
+		// whether something is a part of the Operating System, or from
+		// the User's program.
+		__addSymbol(program, name, symbols[i].address, 0)->fromOS =
+			true;
+	}
+}
+
+/*
+ * If started up without assembling before hand, the program won't be aware
+ * of the symbols in the file that will be needed in the output of the program
+ * in memory.
+ */
+
+void populateSymbolsFromFile(struct program *program)
+{
+	if (NULL == program->symbolfile) {
+		program->symbolfile = symbolFileFor(program->objectfile);
+	}
+
+	populateSymbols(program, program->symbolfile);
+}
+
+/*
+ * Retrieve the hex form of the conditions supplied by the BR instruction.
+ */
+
+static uint16_t nzp(char const *const _nzp, int length)
+{
+	uint16_t __nzp = 0;
+
+	for (int i = 0; i < length; i++) {
+		if ('N' == toupper(_nzp[i])) {
+			__nzp |= 0x0800;
+		} else if ('Z' == toupper(_nzp[i])) {
+			__nzp |= 0x0400;
+		} else if ('P' == toupper(_nzp[i])) {
+			__nzp |= 0x0200;
+		} else {
+			return 0x1;
+		}
+	}
+
+	return (uint16_t) (__nzp ? __nzp : 0x0e00);
+}
+
+// Every nibble, written out in binary and in hex.
+static char const binaryDigits[16][4] = {
+	"0000", "0001", "0010", "0011", "0100", "0101", "0110", "0111",
+	"1000", "1001", "1010", "1011", "1100", "1101", "1110", "1111",
+};
+static char const hexDigits[] = "0123456789ABCDEF";
+
+// The symbol file's header, and how far its names are padded.
+static char const symHeader[] =
+	"// Symbol table\n"
+	"// Scope level 0:\n"
+	"//\tSymbol Name        Page Address\n"
+	"//\t-----------------  ------------\n";
+#define SYM_NAME_WIDTH 18
+
+/*
+ * Write a word as four hex digits, at the given place.
+ */
+
+static void hexWord(char *at, uint16_t word)
+{
+	at[0] = hexDigits[word >> 12];
+	at[1] = hexDigits[word >> 8 & 0xf];
+	at[2] = hexDigits[word >> 4 & 0xf];
+	at[3] = hexDigits[word & 0xf];
+}
+
+/*
+ * Each of these renders the whole of one output file into a buffer of its own.
+ *
+ * Returns: The buffer, which the caller frees, with its size in size.
+ */
+
+static char *objRender(struct image const *image, size_t *size)
+{
+	unsigned char *bytes = malloc(2 * image->count + 1);
+	if (NULL == bytes) {
+		perror("LC3-Simulator");
+		exit(EXIT_FAILURE);
+	}
+
+	// Big endian, whatever the machine we're on.
+	for (size_t i = 0; i < image->count; i++) {
+		bytes[2 * i]     = (unsigned char) (image->words[i] >> 8);
+		bytes[2 * i + 1] = (unsigned char) (image->words[i] & 0xff);
+	}
+
+	*size = 2 * image->count;
+	return (char *) bytes;
+}
+
+static char *binRender(struct image const *image, size_t *size)
+{
+	char *text = malloc(17 * image->count + 1);
+	if (NULL == text) {
+		perror("LC3-Simulator");
+		exit(EXIT_FAILURE);
+	}
+
+	char *at = text;
+	for (size_t i = 0; i < image->count; i++, at += 17) {
+		memcpy(at,      binaryDigits[image->words[i] >> 12], 4);
+		memcpy(at + 4,  binaryDigits[image->words[i] >> 8 & 0xf], 4);
+		memcpy(at + 8,  binaryDigits[image->words[i] >> 4 & 0xf], 4);
+		memcpy(at + 12, binaryDigits[image->words[i] & 0xf], 4);
+		at[16] = '\n';
+	}
+
+	*size = (size_t) (at - text);
+	return text;
+}
+
+static char *hexRender(struct image const *image, size_t *size)
+{
+	char *text = malloc(5 * image->count + 1);
+	if (NULL == text) {
+		perror("LC3-Simulator");
+		exit(EXIT_FAILURE);
+	}
+
+	char *at = text;
+	for (size_t i = 0; i < image->count; i++, at += 5) {
+		hexWord(at, image->words[i]);
+		at[4] = '\n';
+	}
+
+	*size = (size_t) (at - text);
+	return text;
+}
+
+static char *symRender(struct program const *program, size_t *size)
+{
+	struct symbolTable const *table = &program->symbols;
+	size_t length = sizeof(symHeader) - 1;
+
+	for (size_t i = 0; i < table->count; i++) {
+		size_t name = strlen(table->symbols[i]->name);
+
+		// "//\t", the padded name, a space, the address, and "\n".
+		length += 3 + (name > SYM_NAME_WIDTH ? name : SYM_NAME_WIDTH) +
+			  1 + 4 + 1;
+	}
+
+	char *text = malloc(length + 1);
+	if (NULL == text) {
+		perror("LC3-Simulator");
+		exit(EXIT_FAILURE);
+	}
+
+	char *at = text;
+	memcpy(at, symHeader, sizeof(symHeader) - 1);
+	at += sizeof(symHeader) - 1;
+
+	for (size_t i = 0; i < table->count; i++) {
+		struct symbol const *symbol = table->symbols[i];
+		size_t name = strlen(symbol->name);
+
+		if (symbol->fromOS) {
+			continue;
+		}
+
+		memcpy(at, "//\t", 3);
+		memcpy(at + 3, symbol->name, name);
+		at += 3 + name;
+		for (; name < SYM_NAME_WIDTH; name++) {
+			*at++ = ' ';
+		}
+		*at++ = ' ';
+		hexWord(at, symbol->address);
+		at[4] = '\n';
+		at += 5;
+	}
+
+	*size = (size_t) (at - text);
+	return text;
+}
+
+static char *symcRender(struct program const *program, size_t *size)
+{
+	struct symbolTable const *table = &program->symbols;
+	struct cacheHeader header = {
+		.magic = SYMBOL_CACHE_MAGIC,
+		.version = SYMBOL_CACHE_VERSION,
+	};
+
+	for (size_t i = 0; i < table->count; i++) {
+		if (!table->symbols[i]->fromOS) {
+			header.count++;
+			header.poolSize += (uint32_t) strlen(table->symbols[i]->name) + 1;
+		}
+	}
+
+	*size = sizeof(header) + header.count * sizeof(struct cacheEntry) +
+		header.poolSize;
+
+	char *data = malloc(*size);
+	if (NULL == data) {
+		perror("LC3-Simulator");
+		exit(EXIT_FAILURE);
+	}
+
+	struct cacheEntry *entry = (struct cacheEntry *) (data + sizeof(header));
+	char *pool = (char *) (entry + header.count);
+	uint32_t at = 0;
+
+	memcpy(data, &header, sizeof(header));
+
+	for (size_t i = 0; i < table->count; i++) {
+		struct symbol const *symbol = table->symbols[i];
+		size_t length = strlen(symbol->name) + 1;
+
+		if (symbol->fromOS) {
+			continue;
+		}
+
+		*entry++ = (struct cacheEntry) {
+			.name = at,
+			.hash = symbol->hash,
+			.address = symbol->address,
+		};
+		memcpy(pool + at, symbol->name, length);
+		at += (uint32_t) length;
+	}
+
+	return data;
+}
+
+/*
+ * Replace the file with the given contents, in as few writes as it takes. They
+ * go to a new file that is then renamed over the old one, as a simulator could
+ * have the old one mapped (see populateSymbolsFromCache()), and cutting it
+ * short under it would kill it the next time it looked at a name. Every call
+ * gets a new file of its own, as several programs being assembled at once
+ * could be writing to the same place.
+ *
+ * Returns: false if the file couldn't be written.
+ */
+
+static atomic_ulong temporaries = 0;
+
+static bool writeFile(char const *fileName, char const *text, size_t size)
+{
+	char temporary[PATH_MAX];
+	int fd = -1;
+
+	while (-1 == fd) {
+		int length = snprintf(temporary, sizeof(temporary),
+				      "%s.%ld.%lu.tmp", fileName, (long) getpid(),
+				      atomic_fetch_add(&temporaries, 1));
+		if (length < 0 || (size_t) length >= sizeof(temporary)) {
+			errno = ENAMETOOLONG;
+			perror("LC3-Simulator");
+			return false;
+		}
+
+		fd = open(temporary, O_WRONLY | O_CREAT | O_EXCL, 0666);
+		if (-1 == fd && EEXIST != errno) {
+			perror("LC3-Simulator");
+			return false;
+		}
+	}
+
+	while (size) {
+		ssize_t written = write(fd, text, size);
+
+		if (-1 == written && EINTR == errno) {
+			continue;
+		} else if (-1 == written) {
+			perror("LC3-Simulator");
+			close(fd);
+			unlink(temporary);
+			return false;
+		}
+
+		text += written;
+		size -= (size_t) written;
+	}
+
+	close(fd);
+
+	if (-1 == rename(temporary, fileName)) {
+		perror("LC3-Simulator");
+		unlink(temporary);
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * Check whether the next token is a comment.
+ */
+
+static bool iscomment(struct source *source)
+{
+	char const *at = source->at;
+
+	return (at < source->end && ';' == at[0]) ||
+	       (at + 1 < source->end && '/' == at[0] && '/' == at[1]);
+}
+
+/*
+ * Check whether we have reached the end of the line.
+ */
+
+static bool endOfLine(struct source *source)
+{
+	int c = skipWhitespace(source);
+
+	return '\n' == c || EOF == c || iscomment(source);
+}
+
+static const size_t hashed_letters[26] = {
+        100363, 99989, 97711, 97151, 92311, 80147,
+        82279,  72997, 66457, 65719, 70957, 50262,
         48407,  51151, 41047, 39371, 35401, 37039,
         28697,  27791, 20201, 21523, 6449,  4813,
         16333,  13337,
@@ -516,7 +1220,8 @@ static size_t hash(const char *const string, size_t length) {
 }
 
 /*
- * Read the given file to find what the next token is.
+ * Read the source to find what the next token is, leaving the token itself in
+ * the given slice.
  *
  * If we've reached the end of the file, then we return OP_NONE to signal
  * we've finished.
@@ -526,19 +1231,26 @@ static size_t hash(const char *const string, size_t length) {
  * is a label.
  */
 
-static enum Token nextToken(FILE *file, char *buffer)
+static enum Token nextToken(struct source *source, struct slice *word)
 {
-	if (EOF == fscanf(file, "%99s", buffer)) {
-		*buffer = '\0';
+        *word = nextWord(source);
+        if (!word->length) {
                 return OP_NONE;
-	}
+        }
+
+        // Nothing longer than .STRINGZ can be anything but a label.
+        char upper_copy[sizeof(".STRINGZ")] = { 0 };
 
-        char upper_copy[100] = { 0 };
+        if ((size_t) word->length >= sizeof(upper_copy)) {
+                return OP_LABEL;
+        }
 
         enum Token token;
 
-        copy_upper(buffer, upper_copy);
-        size_t hashed = hash(upper_copy, strlen(upper_copy));
+        for (int i = 0; i < word->length; ++i) {
+                upper_copy[i] = (char) toupper((unsigned char) word->text[i]);
+        }
+        size_t hashed = hash(upper_copy, (size_t) word->length);
 
         switch (hashed) {
         case 0x00c847e7858f3bda:  // hash("ADD")
@@ -659,37 +1371,28 @@ static enum Token nextToken(FILE *file, char *buffer)
 }
 
 /*
- * Sometimes, we might come across an instruction that looks something like
- * the following (Note the trailing comment):
+ * Read the label used by an instruction, e.g. the 'LABEL' in:
  * 	LD R2, LABEL; Hello
  *
- * The way that the file is read to grab that label would mean that we get the
- * extraneous parts (the '; Hello'), but we don't want that part, we just want
- * 'LABEL' as the label.
- * So, we want to remove any extraneous parts from the label, and return them to
- * the file.
+ * The label ends at whitespace, or at anything that can't be part of it (the
+ * '; Hello'), which is left in the source.
+ *
+ * Returns: false if there was no label before the end of the line.
  */
 
-static void extractLabel(char *label, FILE *file)
+static bool nextLabel(struct source *source, struct slice *label)
 {
-	size_t length = strlen(label);
-	size_t i = 0;
+	skipWhitespace(source);
 
-	for (; i < length; i++) {
-		if (';' == label[i] || ':' == label[i] ||
-				('/' == label[i] && '/' == label[i + 1])) {
-			break;
-		}
-	}
+	label->text = source->at;
+	source->at = findLabelEnd(source->at, source->end);
+	label->length = (int) (source->at - label->text);
 
-	for (; --length >= i;) {
-		ungetc(label[length], file);
-		label[length] = '\0';
-	}
+	return label->length > 0;
 }
 
 /*
- * Find the next immediate value in the file. If found, return it.
+ * Find the next immediate value in the source. If found, return it.
  *
  * An immediate value takes the form:
  * 	allowedComma = True:
@@ -700,86 +1403,95 @@ static void extractLabel(char *label, FILE *file)
  * 	e.g. ' #2'  or ' x2'  or '    -2'
  *
  * If the value isn't found, or is in the wrong format, return INT_MAX as an
- * error.
+ * error, and leave the source as it was. A label that only starts like a
+ * number (BAD_TRAP, XRAY) doesn't count as one.
  *
  */
 
-static int nextImmediate(FILE *file, bool allowedComma)
+static int nextImmediate(struct source *source, bool allowedComma)
 {
 	int c;
-	int immediate;
+	int digit;
 	int base;
-	char line[MAX_LABEL_LENGTH];
-	char *end = NULL;
+	long immediate = 0;
+	bool negative = false, digits = false, valid = true;
+	char const *start;
 
-	skipWhitespace(file);
+	skipWhitespace(source);
 
-	c = fgetc(file);
-	memset(line, 0, MAX_LABEL_LENGTH);
+	start = source->at;
+	c = nextChar(source);
 
 	if (allowedComma && ',' == c) {
-		skipWhitespace(file);
-		c = fgetc(file);
+		skipWhitespace(source);
+		start = source->at;
+		c = nextChar(source);
 	}
 
 	if ('-' == c) {
 		base = 10;
-		line[0] = '-';
+		negative = true;
 	} else if ('#' == c) {
 		base = 10;
-		c = fgetc(file);
+		c = nextChar(source);
 		if ('-' == c) {
-			line[0] = '-';
+			negative = true;
 		} else {
-			line[0] = '0';
-			ungetc(c, file);
+			digits = true;
+			putBack(source, c);
 		}
 	} else if ('X' == toupper(c)) {
 		base = 16;
-		line[0] = '0';
 	} else if (isdigit(c)) {
+                digits = true;
                 if ('0' == c) {
-                        c = fgetc(file);
+                        c = nextChar(source);
                         if ('X' == toupper(c)) {
                                 base = 16;
-                                line[0] = '0';
                         } else if ('B' == toupper(c)) {
                                 base = 2;
-                                line[0] = '0';
                         } else {
-                                ungetc(c, file);
+                                putBack(source, c);
                                 base = 10;
                         }
                 } else {
                         base = 10;
-                        line[0] = (char) c;
+                        immediate = c - '0';
                 }
         } else if ('B' == toupper(c)) {
                 base = 2;
-                line[0] = '0';
 	} else {
-		ungetc(c, file);
+		putBack(source, c);
 		return INT_MAX;
 	}
 
-	c = fgetc(file);
-	for (size_t i = 1; i < MAX_LABEL_LENGTH && isxdigit(c); i++) {
-		line[i] = (char) c;
-		c = fgetc(file);
+	// Anything too big for the LC-3 is only kept big enough to be refused.
+	while ((digit = digitValue(c = nextChar(source))) < 16) {
+		digits = true;
+		if (digit >= base) {
+			valid = false;
+		} else if (immediate < INT_MAX / 16) {
+			immediate = immediate * base + digit;
+		}
 	}
-	ungetc(c, file);
+	putBack(source, c);
 
-	immediate = (int) strtol(line, &end, base);
+	// Something like BAD_TRAP or XRAY is a label, not a number, and is
+	// left for whoever wants to read it as one.
+	if ('_' == c || isalnum(c)) {
+		valid = false;
+	}
 
-	if (*end) {
+	if (!digits || !valid) {
+		source->at = start;
 		return INT_MAX;
 	} else {
-		return immediate;
+		return (int) (negative ? -immediate : immediate);
 	}
 }
 
 /*
- * Read the file until we hit the next register in the form of:
+ * Read the source until we hit the next register in the form of:
  * 	allowedComma = True (as in, it's not the first operand)
  * 	--> ([ \t]*[,][ \t]+|[ \t]+)[rR][0-7]
  * 	e.g. ' , R1'
@@ -791,25 +1503,25 @@ static int nextImmediate(FILE *file, bool allowedComma)
  * Otherwise, return which register it was (to decimal).
  */
 
-static uint16_t nextRegister(FILE *file, bool allowedComma)
+static uint16_t nextRegister(struct source *source, bool allowedComma)
 {
 	int c;
-	skipWhitespace(file);
+	skipWhitespace(source);
 
-	c = fgetc(file);
+	c = nextChar(source);
 	if (allowedComma && ',' == c) {
-		skipWhitespace(file);
-		c = fgetc(file);
+		skipWhitespace(source);
+		c = nextChar(source);
 	}
 
 	if ('R' != toupper(c)) {
-		ungetc(c, file);
+		putBack(source, c);
 		return 65535;
 	}
 
-	c = fgetc(file);
+	c = nextChar(source);
 	if (c < '0' || c > '7') {
-		ungetc(c, file);
+		putBack(source, c);
 		return 65535;
 	}
 
@@ -918,241 +1630,547 @@ static void create_files_for(struct program *program)
 	}
 }
 
-bool parse(struct program *program)
-{
-	uint16_t instruction = 0, pc = 0, operandOne, operandTwo, realPc = 0;
-	int c, currentLine = 1, errors = 0, operandThree, pass = 1, errorCount = 0;
-	char line[100] = { 0 }, label[MAX_LABEL_LENGTH], *end;
-	bool origSeen = false, endSeen = false;
+/*
+ * What a label is being used for, which decides how much room there is for it
+ * in the instruction.
+ */
 
-	enum Token tok;
-	struct symbol *sym;
+enum fixupKind {
+	BRANCH,         // BR, with a 9 bit PC offset.
+	SUBROUTINE,     // JSR, with an 11 bit PC offset.
+	MEMORY,         // LD, LDI, LEA, ST, STI, with a 9 bit PC offset.
+	WORD,           // .FILL, which takes the whole address.
+};
 
-        if (NULL == program->assemblyfile) {
-		fprintf(stderr, "No assembly file provided.\n");
-                return false;
-        }
+/*
+ * A use of a label, to be filled in once we know where the label is.
+ */
 
-	create_files_for(program);
+/*
+ * Messages held back until everything that goes before them has been said.
+ * The assembler says what it has to about the labels at the very end, once
+ * they're all known, and those messages go in between the others so that
+ * everything is still printed in line order. A mark is left wherever a new
+ * line's messages start.
+ */
 
-	FILE *asmFile = fopen(program->assemblyfile, "r");
-	if (NULL == asmFile) {
-		perror("LC3-Simulator");
-		exit(EXIT_FAILURE);
-	}
+struct mark
+{
+	int line;
+	long outAt, errAt;
+};
 
-	// This isn't the best place for this as it populates the symbol table
-	// with information we don't need to show.
-	populateOSSymbols();
-	OSInstalled = true;
+struct held
+{
+	FILE *out, *err;
+	char *outText, *errText;
+	size_t outSize, errSize;
 
-	puts("STARTING FIRST PASS...");
+	struct mark *marks;
+	size_t count, capacity;
+};
+
+/*
+ * Note that what's said next is about the given line.
+ */
+
+static void hold(struct held *held, int line)
+{
+	if (held->count && line == held->marks[held->count - 1].line) {
+		return;
+	}
+
+	if (held->count == held->capacity) {
+		held->capacity = held->capacity ? held->capacity * 2 : 64;
+		held->marks = realloc(held->marks,
+				      held->capacity * sizeof(struct mark));
+		if (NULL == held->marks) {
+			perror("LC3-Simulator");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	held->marks[held->count++] = (struct mark) {
+		.line = line,
+		.outAt = ftell(held->out),
+		.errAt = ftell(held->err),
+	};
+}
+
+static void openHeld(struct program const *program, struct held *held)
+{
+	*held = (struct held) { 0 };
+
+	held->out = open_memstream(&held->outText, &held->outSize);
+	held->err = program->messages ? held->out :
+		    open_memstream(&held->errText, &held->errSize);
+	if (NULL == held->out || NULL == held->err) {
+		perror("LC3-Simulator");
+		exit(EXIT_FAILURE);
+	}
+
+	// Anything said before the first line goes first.
+	hold(held, 0);
+}
+
+static void closeHeld(struct held *held)
+{
+	if (held->err != held->out) {
+		fclose(held->err);
+	}
+	fclose(held->out);
+}
+
+/*
+ * Print what was said about one line.
+ */
+
+static void writeHeld(struct held const *held, size_t index, FILE *out,
+		      FILE *err)
+{
+	struct mark const *mark = &held->marks[index];
+	long outEnd = (long) held->outSize, errEnd = (long) held->errSize;
+
+	if (index + 1 < held->count) {
+		outEnd = mark[1].outAt;
+		errEnd = mark[1].errAt;
+	}
+
+	if (outEnd > mark->outAt) {
+		fwrite(held->outText + mark->outAt, 1,
+		       (size_t) (outEnd - mark->outAt), out);
+	}
+
+	if (held->err != held->out && errEnd > mark->errAt) {
+		fwrite(held->errText + mark->errAt, 1,
+		       (size_t) (errEnd - mark->errAt), err);
+	}
+}
+
+/*
+ * Print everything that was held back in both, in line order. Where both had
+ * something to say about the same line, the first goes first.
+ */
+
+static void release(struct held *first, struct held *second, FILE *out,
+		    FILE *err)
+{
+	size_t i = 0, j = 0;
+
+	closeHeld(first);
+	closeHeld(second);
+
+	while (i < first->count || j < second->count) {
+		if (j == second->count ||
+		    (i < first->count &&
+		     first->marks[i].line <= second->marks[j].line)) {
+			writeHeld(first, i++, out, err);
+		} else {
+			writeHeld(second, j++, out, err);
+		}
+	}
+
+	free(first->outText);
+	free(first->errText);
+	free(first->marks);
+	free(second->outText);
+	free(second->errText);
+	free(second->marks);
+}
+
+struct fixup
+{
+	enum fixupKind kind;
+	uint16_t *word;
+	struct slice label;
+	struct symbol const *sym;
+	char operation[8];
+	uint16_t pc;
+	uint16_t reg;
+	int line;
+};
+
+/*
+ * Fill in the label's address (or its offset from the PC) in the instruction.
+ *
+ * Returns: 0 on success, 1 if the label is out of reach.
+ */
+
+static int patch(struct program const *program, struct held *held,
+		 struct fixup const *fixup, struct symbol const *sym,
+		 uint16_t *instruction)
+{
+	FILE *out = held->out, *err = held->err;
+	int offset = sym->address - fixup->pc;
+	int bits = SUBROUTINE == fixup->kind ? 11 : 9;
+
+	if (WORD == fixup->kind) {
+		*instruction = sym->address;
+		return 0;
+	}
+
+	if (offset < -(1 << (bits - 1)) || offset >= 1 << (bits - 1)) {
+		hold(held, fixup->line);
+		if (MEMORY == fixup->kind) {
+			ERROR("Line %3d: Label is too far away ( %s  %d  %d   %s )",
+			      fixup->line, fixup->operation, fixup->reg, offset,
+			      sym->name);
+		} else {
+			ERROR("Line %3d: Label is too far away", fixup->line);
+		}
+		return 1;
+	}
+
+	*instruction |= (uint16_t) (offset & ((1 << bits) - 1));
+
+	if (program->verbosity) {
+		hold(held, fixup->line);
+		if (program->verbosity > 2) {
+			fprintf(out, "Line %3d:  ", fixup->line);
+		}
+		fprintf(out, "%-5s  R%d  %-30s  (%4d address%s away)\n",
+			fixup->operation, fixup->reg, sym->name, offset,
+			offset > 1 ? "es" : "");
+	}
+
+	return 0;
+}
+
+/*
+ * One label, instruction, or directive, as it was lexed. Everything that
+ * depends on what came before it (its address, whether we've seen .ORIG or
+ * .END, which labels already exist) is left until the statements are put
+ * back together in order.
+ */
+
+struct statement
+{
+	enum Token tok;
+	int line;
+	struct slice word;
+	struct slice label;     // The label it uses, if any.
+	long outEnd;            // Where this statement's messages end in the
+	long errEnd;            // chunk's streams (they start where the last
+				// statement's end).
+	uint32_t firstWord;     // The characters of a .STRINGZ, in the chunk's
+	uint32_t words;         // words.
+	int operand;            // The origin for .ORIG, the size for .BLKW.
+	int errors;
+	uint16_t instruction;
+	uint16_t reg;           // The register, for a fixup to print.
+	enum fixupKind kind;
+	bool complete;          // Wasn't stopped short by an error.
+	bool tooMany;           // Complete, but with operands left over.
+};
+
+/*
+ * A run of whole lines of the source, which are lexed separately from (and
+ * at the same time as) the rest.
+ */
+
+struct chunk
+{
+	struct program const *program;
+	struct source source;
+	int firstLine;
+	bool spansLines;
+
+	FILE *out, *err;
+	char *outText, *errText;
+	size_t outSize, errSize;
+	long outEnd, errEnd;
+
+	struct statement *statements;
+	size_t count, capacity;
+
+	uint16_t *words;
+	size_t wordCount, wordCapacity;
+};
+
+// Files are split into chunks of at least this many bytes, so that small
+// ones aren't split at all.
+#define CHUNK_SIZE (256 * 1024)
+
+// Likewise for the number of fixups looked up by each thread.
+#define FIXUPS_PER_THREAD 4096
+
+/*
+ * How many threads to split the given amount of work between.
+ */
+
+static size_t threadsFor(size_t amount, size_t each)
+{
+	long processors = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t threads = amount / each;
+
+	if (processors > 0 && threads > (size_t) processors) {
+		threads = (size_t) processors;
+	}
+
+	return threads ? threads : 1;
+}
+
+/*
+ * Call work on each of the count items (of the given size), each on its own
+ * thread, and wait for them all to finish.
+ */
+
+static void inParallel(void *(*work)(void *), void *items, size_t size,
+		       size_t count)
+{
+	pthread_t *threads = malloc(count * sizeof(pthread_t));
+	if (NULL == threads) {
+		perror("LC3-Simulator");
+		exit(EXIT_FAILURE);
+	}
+
+	// The first item is done on this thread, rather than waiting around.
+	for (size_t i = 1; i < count; i++) {
+		if (pthread_create(&threads[i], NULL, work,
+				   (char *) items + i * size)) {
+			perror("LC3-Simulator");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	work(items);
+
+	for (size_t i = 1; i < count; i++) {
+		pthread_join(threads[i], NULL);
+	}
+
+	free(threads);
+}
+
+static struct statement *newStatement(struct chunk *chunk)
+{
+	if (chunk->count == chunk->capacity) {
+		chunk->capacity = chunk->capacity ? chunk->capacity * 2 : 256;
+		chunk->statements = realloc(chunk->statements,
+				chunk->capacity * sizeof(struct statement));
+		if (NULL == chunk->statements) {
+			perror("LC3-Simulator");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	return &chunk->statements[chunk->count++];
+}
+
+static void addWord(struct chunk *chunk, uint16_t word)
+{
+	if (chunk->wordCount == chunk->wordCapacity) {
+		chunk->wordCapacity = chunk->wordCapacity ?
+				      chunk->wordCapacity * 2 : 256;
+		chunk->words = realloc(chunk->words,
+				       chunk->wordCapacity * sizeof(uint16_t));
+		if (NULL == chunk->words) {
+			perror("LC3-Simulator");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	chunk->words[chunk->wordCount++] = word;
+	chunk->statements[chunk->count - 1].words++;
+}
+
+/*
+ * Note where the last statement's messages end. Asking the streams isn't
+ * free, so it's only done when the statement could have said something.
+ */
+
+static void finishStatement(struct chunk *chunk)
+{
+	struct statement *statement;
+
+	if (!chunk->count) {
+		return;
+	}
+
+	statement = &chunk->statements[chunk->count - 1];
+
+	if (chunk->program->verbosity || statement->errors ||
+	    DIR_ORIG == statement->tok) {
+		chunk->outEnd = ftell(chunk->out);
+		chunk->errEnd = ftell(chunk->err);
+	}
+
+	statement->outEnd = chunk->outEnd;
+	statement->errEnd = chunk->errEnd;
+}
+
+/*
+ * Lex every statement in a chunk, and encode as much of each as can be done
+ * without knowing what came before it.
+ */
+
+static void *lexChunk(void *data)
+{
+	struct chunk *chunk = data;
+	struct program const *program = chunk->program;
+	struct source *source = &chunk->source;
+
+	uint16_t instruction, operandOne, operandTwo;
+	int c, skipped, currentLine = chunk->firstLine, operandThree;
+
+	enum Token tok;
+	struct slice word, label;
+	struct statement *statement;
+	struct fixup fixup;
+
+	FILE *out = chunk->out;
+	FILE *err = chunk->err;
 
 	while (1) {
-		memset(line, 0, sizeof(line));
-		memset(label, 0, MAX_LABEL_LENGTH);
 		instruction = 0;
 		operandOne = 0;
 
-		skipWhitespace(asmFile);
-		c = fgetc(asmFile);
+		fixup = (struct fixup) {
+			.word = NULL,
+		};
+
+		skipped = skipWhitespace(source);
+		c = nextChar(source);
 
 		if (EOF == c) {
-			if (2 == pass) {
-				printf("%d error%s found in second pass.\n",
-					errors, 1 != errors ? "'s" : "");
-				break;
-			}
-			printf("%d error%s found in first pass.\n",
-				errors, 1 == errors ? "" : "'s");
-			puts("STARTING SECOND PASS...");
-			pass = 2;
-			pc = realPc;
-			rewind(asmFile);
-			currentLine = 1;
-			errorCount = errors;
-			errors = 0;
-			endSeen = false;
-			continue;
+			break;
 		} else if ('\n' == c) {
 			currentLine++;
 			continue;
 		} else  if (';' == c) {
-			nextLine(asmFile);
+			nextLine(source);
 			continue;
 		} else if ('/' == c) {
-			c = fgetc(asmFile);
-			if ('/' == lastSkippedChar || '/' == c) {
-				nextLine(asmFile);
+			c = nextChar(source);
+			if ('/' == skipped || '/' == c) {
+				nextLine(source);
 				continue;
 			}
-			ungetc(c, asmFile);
+			putBack(source, c);
 		}
 
-		ungetc(c, asmFile);
-		tok = nextToken(asmFile, line);
-		skipWhitespace(asmFile);
+		putBack(source, c);
+		tok = nextToken(source, &word);
+		skipWhitespace(source);
 
-		if (origSeen) {
-			pc++;
-		}
+		finishStatement(chunk);
+		statement = newStatement(chunk);
+		*statement = (struct statement) {
+			.tok = tok,
+			.word = word,
+			.line = currentLine,
+			.firstWord = (uint32_t) chunk->wordCount,
+		};
 
 		switch (tok) {
 		case DIR_ORIG:
-			if (1 != pass) {
-				instruction = realPc;
-				nextLine(asmFile);
-				break;
-			}
-
-			if (origSeen) {
-                                ERROR("Line %3d: Extra .ORIG directive", currentLine);
-				nextLine(asmFile);
-				errors++;
-				continue;
-			} else if (endSeen) {
-				ERROR("Line %3d: .END seen before .ORIG", currentLine);
-				nextLine(asmFile);
-				errors++;
-				continue;
-			}
-
-			operandThree = nextImmediate(asmFile, false);
+			operandThree = nextImmediate(source, false);
 			if (operandThree > 0xffff || operandThree < 0) {
 				ERROR("Line %3d: Invalid operand for .ORIG", currentLine);
-				nextLine(asmFile);
-				errors++;
+				nextLine(source);
+				statement->errors++;
 				continue;
 			} else if (operandThree < 0x3000 && program->warn) {
                                 WARNING("Line %3d: .ORIG memory address is in OS memory",
                                         currentLine);
                         }
 
-			pc = realPc = (uint16_t) operandThree;
-			origSeen = true;
+			statement->operand = operandThree;
 			break;
 		case DIR_STRINGZ:
-			c = fgetc(asmFile);
+			c = nextChar(source);
 
 			if ('"' != c) {
 				ERROR("Line %3d: No string supplied to .STRINGZ",
                                       currentLine);
-				nextLine(asmFile);
-				errors++;
+				nextLine(source);
+				statement->errors++;
 				continue;
 			}
 
-			memset(line, 0, 100);
-			for (size_t i = 0; '"' != (c = fgetc(asmFile)) &&
-					   i < 100; i++) {
+			while ('"' != (c = nextChar(source)) && EOF != c) {
+				// Strings are the only thing that can go past the
+				// end of a line.
+				if ('\n' == c) {
+					chunk->spansLines = true;
+				}
+
 				if ('\\' == c) {
-					switch (c = fgetc(asmFile)) {
+					switch (c = nextChar(source)) {
 					case 'n':
-						line[i] = '\n';
 						instruction = 0x000a;
 						break;
 					case 't':
-						line[i] = '\t';
 						instruction = 0x0009;
 						break;
 					case '"':
-						line[i] = '"';
 						instruction = 0x0022;
 						break;
 					case '\\':
-						line[i] = '\\';
 						instruction = 0x005c;
 						break;
 					default:
-						ungetc(c, asmFile);
+						putBack(source, c);
 						break;
 					}
 				} else {
-					line[i] = (char) c;
 					instruction = (uint16_t) (c & 0xff);
 				}
 
-				pc++;
-				if (1 != pass) {
-					insert(instruction);
-				}
+				addWord(chunk, instruction);
+			}
+
+			if (EOF == c) {
+				ERROR("Line %3d: Unterminated string", currentLine);
+				statement->errors++;
+				continue;
 			}
 
 			instruction = 0;
-			line[strlen(line)] = '\0';
 			break;
 		case DIR_BLKW:
-			operandThree = nextImmediate(asmFile, false);
+			operandThree = nextImmediate(source, false);
 
 			if (INT_MAX == operandThree) {
 				ERROR("Line %3d: Invalid operand for .BLKW",
                                       currentLine);
+				nextLine(source);
+				statement->errors++;
+				continue;
 			} else if (operandThree < 1) {
 				ERROR("Line %3d: .BLKW requires an argument > 0",
                                       currentLine);
-				nextLine(asmFile);
-				errors++;
+				nextLine(source);
+				statement->errors++;
 				continue;
 			} else if (operandThree > 150) {
 				ERROR("Line %3d: .BLKW requires an argument < 150",
                                       currentLine);
-				nextLine(asmFile);
-				errors++;
+				nextLine(source);
+				statement->errors++;
 				continue;
 			}
 
-			pc += operandThree - 1;
-			if (1 != pass) {
-				instruction = 0;
-				while (operandThree-- > 1) {
-					insert(instruction);
-				}
-			}
+			statement->operand = operandThree;
 			break;
 		case DIR_FILL:
-			if (1 == pass) {
-				nextLine(asmFile);
-				break;
-			}
-
-			operandThree = nextImmediate(asmFile, false);
+			operandThree = nextImmediate(source, false);
 
 			if (INT_MAX == operandThree) {
-				if (EOF == fscanf(asmFile, "%79s", label)) {
-					ERROR("Line %3d: Unexpected end of file", currentLine);
-					ungetc(EOF, asmFile);
-					errors++;
+				if (!nextLabel(source, &label)) {
+					ERROR("Line %3d: No label supplied to %.*s",
+					      currentLine, SLICE(word));
+					statement->errors++;
 					continue;
 				}
 
-				extractLabel(label, asmFile);
-				sym = findSymbol(label);
-
-				if (NULL == sym) {
-					ERROR("Line %3d: Invalid literal for base %d",
-                                              currentLine, operandThree);
-					nextLine(asmFile);
-					errors++;
-					continue;
-				}
-				instruction = sym->address;
+				fixup.kind = WORD;
+				fixup.label = label;
 			} else {
 				instruction = (uint16_t) operandThree;
 			}
 			break;
 		case DIR_END:
-			if (1 != pass) {
-				nextLine(asmFile);
-				endSeen = true;
-				break;
-			}
-
-			if (endSeen) {
-				ERROR("Line %3d: Extra .END directive", currentLine);
-				errors++;
-			}
-
-			endSeen = true;
 			break;
 		case OP_BR:
 		case OP_BRN:            // FALLTHROUGH
@@ -1161,101 +2179,55 @@ bool parse(struct program *program)
 		case OP_BRNZ:           // FALLTHROUGH
 		case OP_BRNP:           // FALLTHROUGH
 		case OP_BRZP:           // FALLTHROUGH
-			if (1 == pass) {
-				nextLine(asmFile);
-				break;
-			}
-
-			instruction = nzp(line + 2);
+			instruction = nzp(word.text + 2, word.length - 2);
 			if (instruction & 7) {
 				ERROR("Line %3d: Invalid BR instruction",
                                       currentLine);
-				errors++;
-				continue;
-			}
-
-			if (EOF == fscanf(asmFile, "%79s", label)) {
-				ERROR("Line %3d: Unexpected end of file",
-                                      currentLine);
-				ungetc(EOF, asmFile);
-				errors++;
+				statement->errors++;
 				continue;
 			}
 
-			extractLabel(label, asmFile);
-			sym = findSymbol(label);
-			if (NULL == sym) {
-				ERROR("Line %3d: Invalid label '%s'",
-                                      currentLine, label);
-				nextLine(asmFile);
-				errors++;
-				continue;
-			}
-
-			operandThree = sym->address - pc + 1;
-			if (operandThree < -256 || operandThree > 255) {
-				ERROR("Line %3d: Label is too far away",
-                                      currentLine);
-				nextLine(asmFile);
-				errors++;
+			if (!nextLabel(source, &label)) {
+				ERROR("Line %3d: No label supplied to %.*s",
+				      currentLine, SLICE(word));
+				statement->errors++;
 				continue;
 			}
 
-                        // Check if the last statement has the same condition code as this one,
-                        // or if the last one was a BR(nzp), in which case it's covered by that
-                        // one.
-                        if (((instruction & 0xFE00) == (listTail->instruction & 0xFE00) ||
-                                        (listTail->instruction & 0xFE00) == 0xFE00) && program->warn) {
-                                WARNING("Line %3d: Statement possibly has no effect, "
-                                                "as last line has same BR condition",
-                                        currentLine);
-                        }
-
-			instruction |= (operandThree & 0x1ff);
-			if (program->verbosity) {
-				if (program->verbosity > 2) {
-					printf("Line %3d:  ", currentLine);
-				}
-				printf("%-5s  R%d  %-30s  (%4d address%s away)\n",
-					line, operandOne, sym->name, operandThree, operandThree > 1 ? "es" : "");
-			}
+			fixup.kind = BRANCH;
+			fixup.label = label;
 			break;
 		case OP_AND:
 			instruction = 0x4000;
 		case OP_ADD:            // FALLTHORUGH
 			instruction += 0x1000;
 
-			if (1 == pass) {
-				nextLine(asmFile);
-				break;
-			}
-
-			operandOne = nextRegister(asmFile, false);
+			operandOne = nextRegister(source, false);
 			if (65535 == operandOne) {
-				ERROR("Line %3d: Invalid operand provided to %s",
-                                      currentLine, line);
-				nextLine(asmFile);
-				errors++;
+				ERROR("Line %3d: Invalid operand provided to %.*s",
+                                      currentLine, SLICE(word));
+				nextLine(source);
+				statement->errors++;
 				continue;
 			}
 
-			operandTwo = nextRegister(asmFile, true);
+			operandTwo = nextRegister(source, true);
 			if (65535 == operandTwo) {
-				ERROR("Line %3d: Invalid operand provided to %s",
-                                      currentLine, line);
-				nextLine(asmFile);
-				errors++;
+				ERROR("Line %3d: Invalid operand provided to %.*s",
+                                      currentLine, SLICE(word));
+				nextLine(source);
+				statement->errors++;
 				continue;
 			}
 
-			operandThree = nextRegister(asmFile, true);
+			operandThree = nextRegister(source, true);
 			if (65535 == operandThree) {
-				operandThree = nextImmediate(asmFile, true);
+				operandThree = nextImmediate(source, true);
 				if (operandThree > 15 || operandThree < -16) {
-					ERROR("Line %3d: Invalid operand provided to %s",
-						currentLine, line);
-					nextLine(asmFile);
-					errors++;
+					ERROR("Line %3d: Invalid operand provided to %.*s",
+						currentLine, SLICE(word));
+					nextLine(source);
+					statement->errors++;
 					continue;
 				}
 				operandThree &= 0x3f;
@@ -1266,50 +2238,45 @@ bool parse(struct program *program)
 								operandTwo << 6 | operandThree);
 			if (program->verbosity) {
 				if (program->verbosity > 2) {
-					printf("Line %3d:  ", currentLine);
+					fprintf(out, "Line %3d:  ", currentLine);
 				}
-				printf("%-5s  R%d  R%d  ", line, operandOne, operandTwo);
+				fprintf(out, "%-5.*s  R%d  R%d  ", SLICE(word), operandOne, operandTwo);
 				if (instruction & 0x20) {
-					printf("#%d", ((int16_t) ((operandThree & 0x3f) << 11)) >> 11);
+					fprintf(out, "#%d", ((int16_t) ((operandThree & 0x3f) << 11)) >> 11);
 				} else {
-					printf("R%d", operandThree & 7);
+					fprintf(out, "R%d", operandThree & 7);
 				}
-				puts("");
+				fputc('\n', out);
 			}
 			break;
 		case OP_NOT:
 			instruction += 0x903f;
 
-			if (1 == pass) {
-				nextLine(asmFile);
-				break;
-			}
-
-			operandOne = nextRegister(asmFile, false);
+			operandOne = nextRegister(source, false);
 			if (65535 == operandOne) {
 				ERROR("Line %3d: Invalid operand provided to NOT",
                                       currentLine);
-				nextLine(asmFile);
-				errors++;
+				nextLine(source);
+				statement->errors++;
 				continue;
 			}
 
-			operandTwo = nextRegister(asmFile, true);
+			operandTwo = nextRegister(source, true);
 			if (65535 == operandTwo) {
 				ERROR("Line %3d: Invalid operand provided to NOT",
                                       currentLine);
-				nextLine(asmFile);
-				errors++;
+				nextLine(source);
+				statement->errors++;
 				continue;
 			}
 
 			instruction |= operandOne << 9 | operandTwo << 6;
 			if (program->verbosity) {
 				if (program->verbosity > 2) {
-					printf("Line %3d:  ", currentLine);
+					fprintf(out, "Line %3d:  ", currentLine);
 				}
-				printf("%-5s  R%d  R%d", line, operandOne, operandTwo);
-				puts("");
+				fprintf(out, "%-5.*s  R%d  R%d", SLICE(word), operandOne, operandTwo);
+				fputc('\n', out);
 			}
 			break;
 		case OP_JMP:
@@ -1317,74 +2284,37 @@ bool parse(struct program *program)
 		case OP_JSRR:           // FALLTHORUGH
 			instruction += 0x4000;
 
-			if (1 == pass) {
-				nextLine(asmFile);
-				break;
-			}
-
-			operandOne = nextRegister(asmFile, false);
+			operandOne = nextRegister(source, false);
 			if (65535 == operandOne) {
-				ERROR("Line %3d: Invalid operand provided to %s",
-                                      currentLine, line);
-				nextLine(asmFile);
-				errors++;
+				ERROR("Line %3d: Invalid operand provided to %.*s",
+                                      currentLine, SLICE(word));
+				nextLine(source);
+				statement->errors++;
 				continue;
 			}
 
 			instruction |= operandOne << 6;
 			if (program->verbosity) {
 				if (program->verbosity > 2) {
-					printf("Line %3d:  ", currentLine);
+					fprintf(out, "Line %3d:  ", currentLine);
 				}
-				printf("%-5s  R%d", line, operandOne);
-				puts("");
+				fprintf(out, "%-5.*s  R%d", SLICE(word), operandOne);
+				fputc('\n', out);
 			}
 			break;
 		case OP_JSR:
 			instruction = 0x4800;
 
-			if (1 == pass) {
-				nextLine(asmFile);
-				break;
-			}
-
-			if (EOF == fscanf(asmFile, "%79s", label)) {
-				ERROR("Line %3d: Unexpected end of file",
-                                      currentLine);
-				ungetc(EOF, asmFile);
-				errors++;
-				continue;
-			}
-
-			extractLabel(label, asmFile);
-			sym = findSymbol(label);
-			if (NULL == sym) {
-				ERROR("Line %3d: Invalid label '%s'",
-                                      currentLine, label);
-				nextLine(asmFile);
-				errors++;
-				continue;
-			}
 
-			operandThree = sym->address - pc + 1;
-			if (operandThree < -1024 || operandThree > 1023) {
-				ERROR("Line %3d: Label is too far away",
-                                      currentLine);
-				nextLine(asmFile);
-				errors++;
+			if (!nextLabel(source, &label)) {
+				ERROR("Line %3d: No label supplied to %.*s",
+				      currentLine, SLICE(word));
+				statement->errors++;
 				continue;
 			}
 
-			instruction |= (operandThree & 0x7ff);
-			if (program->verbosity) {
-				if (program->verbosity > 2) {
-					printf("Line %3d:  ", currentLine);
-				}
-				printf("%-5s  R%d  %-30s  (%4d address%s away)",
-                                        line, operandOne, sym->name, operandThree,
-					operandThree > 1 ? "es" : "");
-				puts("");
-			}
+			fixup.kind = SUBROUTINE;
+			fixup.label = label;
 			break;
 		case OP_LEA:
 			instruction = 0x3000;
@@ -1397,176 +2327,121 @@ bool parse(struct program *program)
 		case OP_LD:             // FALLTHORUGH
 			instruction += 0x2000;
 
-			if (1 == pass) {
-				nextLine(asmFile);
-				break;
-			}
-
-			operandOne = nextRegister(asmFile, false);
+			operandOne = nextRegister(source, false);
 			if (65535 == operandOne) {
-				ERROR("Line %3d: Invalid operand for %s",
-                                      currentLine, line);
-				nextLine(asmFile);
-				errors++;
+				ERROR("Line %3d: Invalid operand for %.*s",
+                                      currentLine, SLICE(word));
+				nextLine(source);
+				statement->errors++;
 				continue;
 			}
 
-			skipWhitespace(asmFile);
-			c = fgetc(asmFile);
-
-			if (',' == c) {
-				skipWhitespace(asmFile);
-			} else {
-				ungetc(c, asmFile);
+			if (',' == skipWhitespace(source)) {
+				nextChar(source);
 			}
 
-			if (EOF == fscanf(asmFile, "%79s", label)) {
-				ERROR("Line %3d: Unexpected end of file",
-                                      currentLine);
-				ungetc(EOF, asmFile);
-				errors++;
+			if (!nextLabel(source, &label)) {
+				ERROR("Line %3d: No label supplied to %.*s",
+				      currentLine, SLICE(word));
+				statement->errors++;
 				continue;
 			}
 
-			extractLabel(label, asmFile);
-			sym = findSymbol(label);
-			if (NULL == sym) {
-				ERROR("Line %3d: Invalid label '%s'", currentLine, label);
-				nextLine(asmFile);
-				errors++;
-				continue;
-			}
-
-			operandThree = sym->address - pc + 1;
-			if (operandThree < -256 || operandThree > 255) {
-				ERROR("Line %3d: Label is too far away ( %s  %d  %d   %s )",
-					currentLine, line, operandOne, operandThree, sym->name);
-				nextLine(asmFile);
-				errors++;
-				continue;
-			}
-
-			instruction |= operandOne << 9 | (operandThree & 0x1ff);
-			if (program->verbosity) {
-				if (program->verbosity > 2) {
-					printf("Line %3d:  ", currentLine);
-				}
-				printf("%-5s  R%d  %-30s  (%4d address%s away)",
-					line, operandOne, sym->name, operandThree,
-					operandThree > 1 ? "es" : "");
-				puts("");
-			}
+			instruction |= operandOne << 9;
+			fixup.kind = MEMORY;
+			fixup.reg = operandOne;
+			fixup.label = label;
 			break;
 		case OP_STR:
 			instruction = 0x1000;
 		case OP_LDR:            // FALLTHROUGH
 			instruction += 0x6000;
 
-			if (1 == pass) {
-				nextLine(asmFile);
-				break;
-			}
-
-			operandOne = nextRegister(asmFile, false);
+			operandOne = nextRegister(source, false);
 			if (65535 == operandOne) {
-				ERROR("Line %3d: Invalid operand provided to %s",
-                                      currentLine, line);
-				nextLine(asmFile);
-				errors++;
+				ERROR("Line %3d: Invalid operand provided to %.*s",
+                                      currentLine, SLICE(word));
+				nextLine(source);
+				statement->errors++;
 				continue;
 			}
 
-			operandTwo = nextRegister(asmFile, true);
+			operandTwo = nextRegister(source, true);
 			if (65535 == operandTwo) {
-				ERROR("Line %3d: Invalid operand provided to %s",
-                                      currentLine, line);
-				nextLine(asmFile);
-				errors++;
+				ERROR("Line %3d: Invalid operand provided to %.*s",
+                                      currentLine, SLICE(word));
+				nextLine(source);
+				statement->errors++;
 				continue;
 			}
 
-			operandThree = nextImmediate(asmFile, true);
+			operandThree = nextImmediate(source, true);
 			if (INT_MAX == operandThree) {
-				ERROR("Line %3d: Invalid operand provided to %s",
-                                      currentLine, line);
-				nextLine(asmFile);
-				errors++;
+				ERROR("Line %3d: Invalid operand provided to %.*s",
+                                      currentLine, SLICE(word));
+				nextLine(source);
+				statement->errors++;
 				continue;
 			} else if (operandThree < -32 || operandThree > 31) {
-				ERROR("Line %3d: Third operand for %s needs to be >= -32 and <= 31",
-                                      currentLine, line);
-				nextLine(asmFile);
-				errors++;
+				ERROR("Line %3d: Third operand for %.*s needs to be >= -32 and <= 31",
+                                      currentLine, SLICE(word));
+				nextLine(source);
+				statement->errors++;
 				continue;
 			}
 
 			instruction |= operandOne << 9 | operandTwo << 6 | (operandThree & 0x3f);
 			if (program->verbosity) {
 				if (program->verbosity > 2) {
-					printf("Line %3d:  ", currentLine);
+					fprintf(out, "Line %3d:  ", currentLine);
 				}
-				printf("%-5s  R%d  R%d  #%d", line, operandOne,
+				fprintf(out, "%-5.*s  R%d  R%d  #%d", SLICE(word), operandOne,
 					operandTwo, operandThree);
-				puts("");
+				fputc('\n', out);
 			}
 			break;
 		case OP_RET:
-			if (1 == pass) {
-				nextLine(asmFile);
-				break;
-			}
-
 			instruction = 0xc1c0;
 			if (program->verbosity) {
 				if (program->verbosity > 2) {
-					printf("Line %3d:  ", currentLine);
+					fprintf(out, "Line %3d:  ", currentLine);
 				}
-				printf("%-4s", line);
-				puts("");
+				fprintf(out, "%-4.*s", SLICE(word));
+				fputc('\n', out);
 			}
 			break;
 		case OP_RTI:
-			if (1 == pass) {
-				nextLine(asmFile);
-				break;
-			}
-
 			if (program->verbosity) {
 				if (program->verbosity > 2) {
-					printf("Line %3d:  ", currentLine);
+					fprintf(out, "Line %3d:  ", currentLine);
 				}
-				printf("%-5s", line);
-				puts("");
+				fprintf(out, "%-5.*s", SLICE(word));
+				fputc('\n', out);
 			}
 			break;
 		case OP_TRAP:
-			if (1 == pass) {
-				nextLine(asmFile);
-				break;
-			}
-
-			operandThree = nextImmediate(asmFile, false);
+			operandThree = nextImmediate(source, false);
 			if (INT_MAX == operandThree) {
 				ERROR("Line %3d: Invalid operand for TRAP",
                                       currentLine);
-				nextLine(asmFile);
-				errors++;
+				nextLine(source);
+				statement->errors++;
 				continue;
 			} else if (operandThree < 0x20 || operandThree > 0x25) {
 				ERROR("Line %3d: Invalid TRAP Routine",
                                       currentLine);
-				nextLine(asmFile);
-				errors++;
+				nextLine(source);
+				statement->errors++;
 				continue;
 			}
 
 			instruction = (uint16_t) (0xf000 + (uint16_t) operandThree);
 			if (program->verbosity) {
 				if (program->verbosity > 2) {
-					printf("Line %3d:  ", currentLine);
+					fprintf(out, "Line %3d:  ", currentLine);
 				}
-				printf("%-5s 0x%x", line, operandThree);
-				puts("");
+				fprintf(out, "%-5.*s 0x%x", SLICE(word), operandThree);
+				fputc('\n', out);
 			}
 			break;
 		case OP_HALT:
@@ -1583,136 +2458,611 @@ bool parse(struct program *program)
 		case OP_GETC:           // FALLTHROUGH
 			instruction += (uint16_t) 0xF020;
 
-			if (1 == pass) {
-				nextLine(asmFile);
-			} else if (program->verbosity) {
+			if (program->verbosity) {
 				if (program->verbosity > 2) {
-					printf("Line %3d:  ", currentLine);
+					fprintf(out, "Line %3d:  ", currentLine);
 				}
-				printf("%-62s", line);
-				puts("");
+				fprintf(out, "%-62.*s", SLICE(word));
+				fputc('\n', out);
 			}
 			break;
 		case OP_LABEL:
 		default:
-			pc--;
-			if (1 == pass) {
-				end = strchr(line, ':');
-				if (NULL != end) {
-					char *colon = end + strlen(end) - 1;
-					for (; colon != end; colon--) {
-						*colon = '\0';
+			break;
+		}
+
+		statement->complete = true;
+		statement->instruction = instruction;
+		statement->label = fixup.label;
+		statement->kind = fixup.kind;
+		statement->reg = fixup.reg;
+
+		if (OP_LABEL != tok && !endOfLine(source)) {
+			ERROR("Line %3d: Too many operands provided for %.*s",
+                              currentLine, SLICE(word));
+			nextLine(source);
+			statement->errors++;
+			statement->tooMany = true;
+		}
+	}
+
+	finishStatement(chunk);
+
+	return NULL;
+}
+
+/*
+ * Split the source into chunks of whole lines, one for each thread, and lex
+ * them all.
+ *
+ * Returns: The number of chunks.
+ */
+
+static size_t lexChunks(struct program const *program, struct source *source,
+			size_t threads, struct chunk **chunks)
+{
+	char const *start = source->data;
+	int line = 1;
+
+	*chunks = calloc(threads, sizeof(struct chunk));
+	if (NULL == *chunks) {
+		perror("LC3-Simulator");
+		exit(EXIT_FAILURE);
+	}
+
+	for (size_t i = 0; i < threads; i++) {
+		struct chunk *chunk = &(*chunks)[i];
+		char const *end = source->end;
+
+		if (i + 1 < threads) {
+			end = findNewline(source->data + (i + 1) * source->size /
+					  threads, source->end);
+			end += end < source->end;
+		}
+
+		if (end < start) {
+			end = start;
+		}
+
+		chunk->program = program;
+		chunk->source = (struct source) {
+			.data = source->data,
+			.at = start,
+			.end = end,
+		};
+		chunk->firstLine = line;
+
+		chunk->out = open_memstream(&chunk->outText, &chunk->outSize);
+		chunk->err = program->messages ? chunk->out :
+			     open_memstream(&chunk->errText, &chunk->errSize);
+		if (NULL == chunk->out || NULL == chunk->err) {
+			perror("LC3-Simulator");
+			exit(EXIT_FAILURE);
+		}
+
+		line += (int) countLines(start, end);
+		start = end;
+	}
+
+	inParallel(lexChunk, *chunks, sizeof(struct chunk), threads);
+
+	for (size_t i = 0; i < threads; i++) {
+		struct chunk *chunk = &(*chunks)[i];
+
+		if (chunk->err != chunk->out) {
+			fclose(chunk->err);
+		}
+		fclose(chunk->out);
+	}
+
+	return threads;
+}
+
+static void freeChunks(struct chunk *chunks, size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		free(chunks[i].outText);
+		free(chunks[i].errText);
+		free(chunks[i].statements);
+		free(chunks[i].words);
+	}
+
+	free(chunks);
+}
+
+/*
+ * Pass on what was said about a statement while it was being lexed.
+ */
+
+static void replay(struct chunk const *chunk, size_t index,
+		   struct held *held)
+{
+	struct statement const *statement = &chunk->statements[index];
+	long outStart = index ? statement[-1].outEnd : 0;
+	long errStart = index ? statement[-1].errEnd : 0;
+	bool saysSomething = statement->outEnd > outStart ||
+			     (chunk->err != chunk->out &&
+			      statement->errEnd > errStart);
+
+	if (!saysSomething) {
+		return;
+	}
+
+	hold(held, statement->line);
+
+	if (statement->outEnd > outStart) {
+		fwrite(chunk->outText + outStart, 1,
+		       (size_t) (statement->outEnd - outStart), held->out);
+	}
+
+	if (chunk->err != chunk->out && statement->errEnd > errStart) {
+		fwrite(chunk->errText + errStart, 1,
+		       (size_t) (statement->errEnd - errStart), held->err);
+	}
+}
+
+/*
+ * Some of the fixups to look up, on one thread.
+ */
+
+struct lookups
+{
+	struct program const *program;
+	struct fixup *fixups;
+	size_t count;
+};
+
+static void *lookUp(void *data)
+{
+	struct lookups *lookups = data;
+
+	for (size_t i = 0; i < lookups->count; i++) {
+		lookups->fixups[i].sym = lookup(lookups->program,
+						lookups->fixups[i].label);
+	}
+
+	return NULL;
+}
+
+/*
+ * Find every label that was used, spreading the fixups between threads.
+ */
+
+static void lookUpAll(struct program const *program, struct fixup *fixups,
+		      size_t count)
+{
+	size_t threads = threadsFor(count, FIXUPS_PER_THREAD);
+	struct lookups *lookups = malloc(threads * sizeof(struct lookups));
+	if (NULL == lookups) {
+		perror("LC3-Simulator");
+		exit(EXIT_FAILURE);
+	}
+
+	for (size_t i = 0; i < threads; i++) {
+		lookups[i] = (struct lookups) {
+			.program = program,
+			.fixups = fixups + i * count / threads,
+			.count = (i + 1) * count / threads - i * count / threads,
+		};
+	}
+
+	inParallel(lookUp, lookups, sizeof(struct lookups), threads);
+
+	free(lookups);
+}
+
+/*
+ * One of the files the assembler writes.
+ */
+
+struct output
+{
+	enum format format;
+	struct program const *program;
+	struct image const *image;
+	bool written;
+};
+
+// Below this many words the output files are written one after the other, as
+// starting threads would take longer than writing them.
+#define WORDS_PER_OUTPUT_THREAD (16 * 1024)
+
+static bool wants(struct program const *program, enum format format)
+{
+	return !program->formats || program->formats & format;
+}
+
+static void *writeOutput(void *data)
+{
+	struct output *output = data;
+	struct program const *program = output->program;
+	char const *fileName = NULL;
+	char *text = NULL, *cacheName;
+	size_t size = 0;
+
+	switch (output->format) {
+	case FORMAT_OBJ:
+		fileName = program->objectfile;
+		text = objRender(output->image, &size);
+		break;
+	case FORMAT_SYM:
+		fileName = program->symbolfile;
+		text = symRender(program, &size);
+		break;
+	case FORMAT_HEX:
+		fileName = program->hexoutfile;
+		text = hexRender(output->image, &size);
+		break;
+	case FORMAT_BIN:
+		fileName = program->binoutfile;
+		text = binRender(output->image, &size);
+		break;
+	case FORMAT_SYMC:
+		break;
+	}
+
+	output->written = true;
+
+	if (NULL != text) {
+		output->written = writeFile(fileName, text, size);
+		free(text);
+	}
+
+	// The cache is only used if it's at least as new as the symbol file, so
+	// it's written after it.
+	if (output->written && (FORMAT_SYMC == output->format ||
+	    (FORMAT_SYM == output->format && wants(program, FORMAT_SYMC)))) {
+		cacheName = cacheFileFor(program->symbolfile);
+		text = symcRender(program, &size);
+		output->written = writeFile(cacheName, text, size);
+		free(text);
+		free(cacheName);
+	}
+
+	return NULL;
+}
+
+/*
+ * Write each of the files the program asked for (or all of them, if it didn't
+ * say), at the same time if there's enough to write.
+ *
+ * Returns: false if any of them couldn't be written.
+ */
+
+static bool writeOutputs(struct program const *program,
+			 struct image const *image)
+{
+	enum format const formats[] = {
+		FORMAT_SYM, FORMAT_HEX, FORMAT_BIN, FORMAT_OBJ, FORMAT_SYMC,
+	};
+	struct output outputs[sizeof(formats) / sizeof(formats[0])];
+	size_t count = 0;
+
+	for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+		// The symbol file brings its cache along with it.
+		if (FORMAT_SYMC == formats[i] && wants(program, FORMAT_SYM)) {
+			continue;
+		}
+
+		if (wants(program, formats[i])) {
+			outputs[count++] = (struct output) {
+				.format = formats[i],
+				.program = program,
+				.image = image,
+			};
+		}
+	}
+
+	if (threadsFor(image->count, WORDS_PER_OUTPUT_THREAD) > 1) {
+		inParallel(writeOutput, outputs, sizeof(struct output), count);
+	} else {
+		for (size_t i = 0; i < count; i++) {
+			writeOutput(&outputs[i]);
+		}
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		if (!outputs[i].written) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool parse(struct program *program)
+{
+	uint16_t instruction = 0, pc = 0;
+	int errors = 0, skippedLine = 0;
+	bool origSeen = false, endSeen = false;
+
+	struct source source;
+	struct slice label;
+	char const *colon;
+	struct chunk *chunks = NULL;
+	size_t chunkCount;
+	struct fixup *fixups = NULL;
+	size_t fixupCount = 0, fixupCapacity = 0;
+	FILE *out = NULL != program->messages ? program->messages : stdout;
+	FILE *err = NULL != program->messages ? program->messages : stderr;
+	FILE *const finalOut = out, *const finalErr = err;
+	struct held pass, labels;
+	struct image *image;
+
+        if (NULL == program->assemblyfile) {
+		fprintf(err, "No assembly file provided.\n");
+                return false;
+        }
+
+	create_files_for(program);
+
+	image = malloc(sizeof(struct image));
+	if (NULL == image || !openSource(program->assemblyfile, &source)) {
+		perror("LC3-Simulator");
+		exit(EXIT_FAILURE);
+	}
+	image->count = 0;
+	image->overflow = 0;
+
+	// This isn't the best place for this as it populates the symbol table
+	// with information we don't need to show.
+	populateOSSymbols(program);
+	program->OSInstalled = true;
+
+	fputs("STARTING ASSEMBLY...\n", out);
+
+	// Large files are lexed in pieces, all at once. If a string ran from
+	// one piece into the next then the pieces don't fit together, so the
+	// file is lexed again in one go.
+	chunkCount = lexChunks(program, &source,
+			       threadsFor(source.size, CHUNK_SIZE), &chunks);
+	for (size_t i = 0; i < chunkCount; i++) {
+		if (chunkCount > 1 && chunks[i].spansLines) {
+			freeChunks(chunks, chunkCount);
+			chunkCount = lexChunks(program, &source, 1, &chunks);
+			break;
+		}
+	}
+
+	// Everything is assembled in a single pass over the file. Every use of a
+	// label leaves a fixup behind, and those are all filled in at the end,
+	// once we know where each label is. What both have to say is held back,
+	// and printed together in line order.
+	openHeld(program, &pass);
+	openHeld(program, &labels);
+	out = pass.out;
+	err = pass.err;
+
+	for (size_t i = 0; i < chunkCount; i++) {
+		struct chunk *chunk = &chunks[i];
+
+		for (size_t j = 0; j < chunk->count; j++) {
+			struct statement *statement = &chunk->statements[j];
+			int currentLine = statement->line;
+			enum Token tok = statement->tok;
+
+			// Whatever else was on a line we gave up on.
+			if (skippedLine == currentLine) {
+				continue;
+			}
+
+			if (endSeen && DIR_END != tok) {
+				if (program->warn) {
+					hold(&pass, currentLine);
+					WARNING("Line %3d: Found %.*s after .END directive. It will be ignored",
+						currentLine, SLICE(statement->word));
+				}
+				skippedLine = currentLine;
+				continue;
+			}
+
+			if (origSeen) {
+				pc++;
+			}
+
+			instruction = statement->instruction;
+
+			switch (tok) {
+			case DIR_ORIG:
+				if (origSeen) {
+					hold(&pass, currentLine);
+					ERROR("Line %3d: Extra .ORIG directive", currentLine);
+					skippedLine = currentLine;
+					errors++;
+					continue;
+				} else if (endSeen) {
+					hold(&pass, currentLine);
+					ERROR("Line %3d: .END seen before .ORIG", currentLine);
+					skippedLine = currentLine;
+					errors++;
+					continue;
+				} else if (statement->complete) {
+					// The origin is the first word of the object file.
+					instruction = pc = (uint16_t) statement->operand;
+					origSeen = true;
+				}
+				break;
+			case DIR_BLKW:
+				if (statement->complete) {
+					pc += statement->operand - 1;
+					if (origSeen) {
+						for (int k = 1; k < statement->operand; k++) {
+							emit(image, 0, currentLine);
+						}
 					}
-					*colon = '\0';
+				}
+				break;
+			case DIR_END:
+				if (endSeen) {
+					hold(&pass, currentLine);
+					ERROR("Line %3d: Extra .END directive", currentLine);
+					errors++;
+				}
+
+				endSeen = true;
+				break;
+			case OP_BR:
+			case OP_BRN:            // FALLTHROUGH
+			case OP_BRZ:            // FALLTHROUGH
+			case OP_BRP:            // FALLTHROUGH
+			case OP_BRNZ:           // FALLTHROUGH
+			case OP_BRNP:           // FALLTHROUGH
+			case OP_BRZP:           // FALLTHROUGH
+				// Check if the last statement has the same condition code as this one,
+				// or if the last one was a BR(nzp), in which case it's covered by that
+				// one.
+				if (statement->complete && image->count &&
+				    ((instruction & 0xFE00) == (image->words[image->count - 1] & 0xFE00) ||
+				     (image->words[image->count - 1] & 0xFE00) == 0xFE00) && program->warn) {
+					hold(&pass, currentLine);
+					WARNING("Line %3d: Statement possibly has no effect, "
+							"as last line has same BR condition",
+						currentLine);
+				}
+				break;
+			case OP_LABEL:
+				pc--;
+				label = statement->word;
+				colon = memchr(label.text, ':', (size_t) label.length);
+				if (NULL != colon) {
+					label.length = (int) (colon - label.text);
+				}
+
+				// TODO: Should this go inside an if block for program->warn?
+				// TODO: If the user doesn't want warnings, then this wouldn't be used..
+				struct symbol *foundSymbol = findSymbolByAddress(program, pc);
+				if (NULL != foundSymbol && program->warn) {
+					// As far as I'm aware this should only happen if a label
+					// has no instruction following it, e.g.:
+					//      .ORIG 0x3000
+					//      LABEL_ONE
+					//      LABEL_TWO   ; Warning thrown for this line
+					//      LABEL_THREE ; Warning also thrown for this line
+					//      .END
+					// Of course, if more than 2 labels share an address this will
+					// compare the last with the first, e.g. in the above example,
+					// the following 2 warnings will be thrown:
+					//       Line   2: 'LABEL_TWO' shares a memory address (0x3000) with 'LABEL_ONE'
+					//       Line   3: 'LABEL_THREE' shares a memory address (0x3000) with 'LABEL_ONE
+					// TODO: Possibly fix this so each symbol has a line number, and they can be
+					// TODO: printed out to help the user find the troublesome code.
+					hold(&pass, currentLine);
+					WARNING("Line %3d: '%.*s' shares a memory address (%#04x) with '%s'",
+						currentLine, SLICE(label), pc,
+						foundSymbol->name);
+					NOTE("Previous label was declared on line %d", foundSymbol->line);
 				}
 
-                                // TODO: Should this go inside an if block for program->warn?
-                                // TODO: If the user doesn't want warnings, then this wouldn't be used..
-                                struct symbol *foundSymbol = findSymbolByAddress(pc);
-                                if (NULL != foundSymbol && program->warn) {
-                                        // As far as I'm aware this should only happen if a label
-                                        // has no instruction following it, e.g.:
-                                        //      .ORIG 0x3000
-                                        //      LABEL_ONE
-                                        //      LABEL_TWO   ; Warning thrown for this line
-                                        //      LABEL_THREE ; Warning also thrown for this line
-                                        //      .END
-                                        // Of course, if more than 2 labels share an address this will
-                                        // compare the last with the first, e.g. in the above example,
-                                        // the following 2 warnings will be thrown:
-                                        //       Line   2: 'LABEL_TWO' shares a memory address (0x3000) with 'LABEL_ONE'
-                                        //       Line   3: 'LABEL_THREE' shares a memory address (0x3000) with 'LABEL_ONE
-                                        // TODO: Possibly fix this so each symbol has a line number, and they can be
-                                        // TODO: printed out to help the user find the troublesome code.
-                                        WARNING("Line %3d: '%s' shares a memory address (%#04x) with '%s'",
-                                                currentLine, line, pc, foundSymbol->name);
-                                        NOTE("Previous label was declared on line %d", foundSymbol->line);
-                                }
-
-				if (addSymbol(line, pc, currentLine)) {
-					ERROR("Line %3d: Multiple definitions of label '%s'",
-                                              currentLine, line);
-					nextLine(asmFile);
+				if (addSymbol(program, label, pc, currentLine)) {
+					hold(&pass, currentLine);
+					ERROR("Line %3d: Multiple definitions of label '%.*s'",
+					      currentLine, SLICE(label));
+					skippedLine = currentLine;
 					errors++;
 				}
 
 				if (program->verbosity) {
+					hold(&pass, currentLine);
 					if (program->verbosity > 2) {
-						printf("Line %3d: ", currentLine);
+						fprintf(out, "Line %3d: ", currentLine);
 					}
-					printf("Found label '%s'", line);
+					fprintf(out, "Found label '%.*s'", SLICE(label));
 					if (program->verbosity > 1) {
-						printf(" with address 0x%4x", pc);
+						fprintf(out, " with address 0x%4x", pc);
 					}
-					puts("");
+					fputc('\n', out);
 				}
+				continue;
+			default:
+				break;
 			}
-			break;
-		}
 
-		if (1 != pass) {
-			if (OP_LABEL != tok) {
-				if (!endOfLine(asmFile)) {
-					ERROR("Line %3d: Too many operands provided for %s",
-                                              currentLine, line);
-					nextLine(asmFile);
-					errors++;
-				} else if (!errors && origSeen && !endSeen) {
-					insert(instruction);
-				}
+			// The characters of a string take up memory, even if the
+			// string wasn't finished.
+			pc += statement->words;
+			for (size_t k = 0; k < statement->words && origSeen; k++) {
+				emit(image, chunk->words[statement->firstWord + k],
+				     currentLine);
 			}
-		} else {
-                        if (endSeen && tok != OP_NONE && uppercmp(line, ".END")) {
-                                if (program->warn) {
-                                        WARNING("Line %3d: Found %s after .END directive. It will be ignored",
-                                                currentLine, line);
-                                }
-                                nextLine(asmFile);
-                        }
-                }
-	}
 
-	errorCount += errors;
-	fclose(asmFile);
+			replay(chunk, j, &pass);
+			errors += statement->errors;
 
-	if (!errorCount) {
-		FILE *symFile = fopen(program->symbolfile, "w+");
-		FILE *hexFile = fopen(program->hexoutfile, "w+");
-		FILE *binFile = fopen(program->binoutfile, "w+");
-		FILE *objFile = fopen(program->objectfile, "wb+");
-		if (NULL == symFile || NULL == hexFile || NULL == binFile ||
-		    NULL == objFile) {
-			perror("LC3-Simulator");
-			exit(EXIT_FAILURE);
-		}
+			if (!statement->complete || statement->tooMany ||
+			    !origSeen || endSeen) {
+				continue;
+			}
+
+			emit(image, instruction, currentLine);
 
-		fprintf(symFile, "// Symbol table\n");
-		fprintf(symFile, "// Scope level 0:\n");
-		fprintf(symFile, "//\tSymbol Name        Page Address\n");
-		fprintf(symFile, "//\t-----------------  ------------\n");
+			// This word uses a label, so it will have to be filled
+			// in later.
+			if (NULL != statement->label.text) {
+				if (fixupCount == fixupCapacity) {
+					fixupCapacity = fixupCapacity ?
+							fixupCapacity * 2 : 64;
+					fixups = realloc(fixups, fixupCapacity *
+							 sizeof(struct fixup));
+					if (NULL == fixups) {
+						perror("LC3-Simulator");
+						exit(EXIT_FAILURE);
+					}
+				}
 
-		for (struct symbolTable *table = tableHead.next; NULL != table;
-		     table = table->next) {
-			if (!table->sym->fromOS) {
-				symWrite(table->sym, symFile);
+				fixups[fixupCount] = (struct fixup) {
+					.kind = statement->kind,
+					.word = &image->words[image->count - 1],
+					.label = statement->label,
+					.pc = pc,
+					.reg = statement->reg,
+					.line = currentLine,
+				};
+				memcpy(fixups[fixupCount++].operation,
+				       statement->word.text,
+				       (size_t) (statement->word.length < 8 ?
+						 statement->word.length : 7));
 			}
 		}
+	}
+
+	freeChunks(chunks, chunkCount);
+
+	lookUpAll(program, fixups, fixupCount);
 
-		for (struct list *list = listHead.next; NULL != list;
-		     list = list->next) {
-			hexWrite(&(list->instruction), hexFile);
-			binWrite(&(list->instruction), binFile);
-			objWrite(&(list->instruction), objFile);
+	out = labels.out;
+	err = labels.err;
+
+	for (size_t i = 0; i < fixupCount; i++) {
+		if (NULL == fixups[i].sym) {
+			hold(&labels, fixups[i].line);
+			ERROR("Line %3d: Invalid label '%.*s'", fixups[i].line,
+			      SLICE(fixups[i].label));
+			errors++;
+		} else if (patch(program, &labels, &fixups[i], fixups[i].sym,
+				 fixups[i].word)) {
+			errors++;
 		}
+	}
 
-		fclose(symFile);
-		fclose(hexFile);
-		fclose(binFile);
-		fclose(objFile);
+	out = finalOut;
+	err = finalErr;
+	release(&pass, &labels, out, err);
+
+	if (image->overflow) {
+		ERROR("Line %3d: Program doesn't fit in memory", image->overflow);
+		errors++;
 	}
 
-	freeList(&listHead);
+	free(fixups);
+	// The labels were pointing into the source, so it has to outlive them.
+	closeSource(&source);
 
-	return !errorCount;
-}
+	fprintf(out, "%d error%s found.\n", errors, 1 == errors ? "" : "'s");
 
+	// A program that assembled but couldn't be written out is no use.
+	bool assembled = !errors && writeOutputs(program, image);
+
+	free(image);
+
+	return assembled;
+}
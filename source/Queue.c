@@ -0,0 +1,93 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Queue.h"
+
+/*
+ * Make a queue of capacity items of the given size. The capacity is rounded
+ * up to a power of two.
+ */
+
+void initQueue(struct queue *queue, size_t size, size_t capacity)
+{
+        size_t rounded = 1;
+
+        while (rounded < capacity) {
+                rounded <<= 1;
+        }
+
+        queue->items = malloc(size * rounded);
+        if (NULL == queue->items) {
+                perror("LC3-Simulator");
+                exit(EXIT_FAILURE);
+        }
+
+        queue->size = size;
+        queue->capacity = rounded;
+        atomic_init(&queue->head, 0);
+        atomic_init(&queue->tail, 0);
+}
+
+void freeQueue(struct queue *queue)
+{
+        free(queue->items);
+        queue->items = NULL;
+}
+
+/*
+ * Called by the producer only.
+ *
+ * Returns: false if the queue was full, and nothing was pushed.
+ */
+
+bool pushQueue(struct queue *queue, void const *item)
+{
+        size_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+        size_t head = atomic_load_explicit(&queue->head, memory_order_acquire);
+
+        if (tail - head == queue->capacity) {
+                return false;
+        }
+
+        memcpy(queue->items + (tail & (queue->capacity - 1)) * queue->size,
+               item, queue->size);
+        // The item has to be there before the consumer can see it is.
+        atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+
+        return true;
+}
+
+/*
+ * Called by the consumer only.
+ *
+ * Returns: false if the queue was empty, and nothing was popped.
+ */
+
+bool popQueue(struct queue *queue, void *item)
+{
+        size_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+        size_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+
+        if (head == tail) {
+                return false;
+        }
+
+        memcpy(item, queue->items + (head & (queue->capacity - 1)) * queue->size,
+               queue->size);
+        // And it has to be copied out before the producer can reuse its slot.
+        atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+
+        return true;
+}
+
+/*
+ * Called by the producer only, to see whether a push would fail.
+ */
+
+bool queueFull(struct queue *queue)
+{
+        return atomic_load_explicit(&queue->tail, memory_order_relaxed) -
+               atomic_load_explicit(&queue->head, memory_order_acquire) ==
+               queue->capacity;
+}
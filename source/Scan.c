@@ -0,0 +1,159 @@
+#include <ctype.h>
+#include <stdbool.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "Scan.h"
+
+#ifdef __SSE2__
+#define CHUNK 16
+
+/*
+ * A bit for every whitespace character (as isspace() sees it in the C locale)
+ * in the 16 bytes at the given address.
+ */
+
+static unsigned spaces(__m128i chunk)
+{
+        // '\t', '\n', '\v', '\f', and '\r' are the five characters from 9.
+        __m128i control = _mm_sub_epi8(chunk, _mm_set1_epi8('\t'));
+        control = _mm_cmpeq_epi8(_mm_min_epu8(control, _mm_set1_epi8(4)),
+                                 control);
+
+        return (unsigned) _mm_movemask_epi8(_mm_or_si128(control,
+                        _mm_cmpeq_epi8(chunk, _mm_set1_epi8(' '))));
+}
+
+static unsigned matches(__m128i chunk, char c)
+{
+        return (unsigned) _mm_movemask_epi8(
+                        _mm_cmpeq_epi8(chunk, _mm_set1_epi8(c)));
+}
+
+static __m128i load(char const *at)
+{
+        return _mm_loadu_si128((__m128i const *) at);
+}
+#endif
+
+static bool isLabelEnd(char const *at, char const *end)
+{
+        return isspace((unsigned char) *at) || ';' == *at || ':' == *at ||
+               ('/' == *at && at + 1 < end && '/' == at[1]);
+}
+
+/*
+ * Skip spaces and tabs (any whitespace, apart from a new line, which is left
+ * for the caller).
+ */
+
+char const *skipBlanks(char const *at, char const *end)
+{
+#ifdef __SSE2__
+        for (; end - at >= CHUNK; at += CHUNK) {
+                __m128i chunk = load(at);
+                unsigned others = ~(spaces(chunk) & ~matches(chunk, '\n')) &
+                                  0xffff;
+
+                if (others) {
+                        return at + __builtin_ctz(others);
+                }
+        }
+#endif
+
+        while (at < end && '\n' != *at && isspace((unsigned char) *at)) {
+                at++;
+        }
+
+        return at;
+}
+
+/*
+ * Find the end of a word, which is the next whitespace character.
+ */
+
+char const *findSpace(char const *at, char const *end)
+{
+#ifdef __SSE2__
+        for (; end - at >= CHUNK; at += CHUNK) {
+                unsigned found = spaces(load(at));
+
+                if (found) {
+                        return at + __builtin_ctz(found);
+                }
+        }
+#endif
+
+        while (at < end && !isspace((unsigned char) *at)) {
+                at++;
+        }
+
+        return at;
+}
+
+/*
+ * Find the end of a label used as an operand: whitespace, or the ':' or
+ * comment that can follow it.
+ */
+
+char const *findLabelEnd(char const *at, char const *end)
+{
+#ifdef __SSE2__
+        for (; end - at >= CHUNK; at += CHUNK) {
+                __m128i chunk = load(at);
+                unsigned found = spaces(chunk) | matches(chunk, ';') |
+                                 matches(chunk, ':') | matches(chunk, '/');
+
+                // A lone '/' is just part of the label.
+                for (; found; found &= found - 1) {
+                        char const *stop = at + __builtin_ctz(found);
+
+                        if (isLabelEnd(stop, end)) {
+                                return stop;
+                        }
+                }
+        }
+#endif
+
+        while (at < end && !isLabelEnd(at, end)) {
+                at++;
+        }
+
+        return at;
+}
+
+/*
+ * Find the new line at the end of this line. memchr() is already vectorised
+ * by the C library, so there's nothing to gain by doing it by hand.
+ */
+
+char const *findNewline(char const *at, char const *end)
+{
+        char const *newline = memchr(at, '\n', (size_t) (end - at));
+
+        return NULL != newline ? newline : end;
+}
+
+/*
+ * Count the new lines in the source.
+ */
+
+size_t countLines(char const *at, char const *end)
+{
+        size_t lines = 0;
+
+#ifdef __SSE2__
+        for (; end - at >= CHUNK; at += CHUNK) {
+                lines += (size_t) __builtin_popcount(matches(load(at), '\n'));
+        }
+#endif
+
+        for (; at < end; at++) {
+                lines += '\n' == *at;
+        }
+
+        return lines;
+}
@@ -0,0 +1,450 @@
+#include <ctype.h>
+#include <stddef.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "Search.h"
+
+#define WORDS 0x10000
+
+// A bit for every address in memory.
+#define CANDIDATE_WORDS (WORDS / 64)
+
+/*
+ * Add a word to a pattern.
+ *
+ * Returns: false if the pattern is already as long as it can be.
+ */
+
+static bool append(struct pattern *pattern, uint16_t mask, uint16_t value)
+{
+        if (SEARCH_LENGTH == pattern->length) {
+                return false;
+        }
+
+        pattern->masks[pattern->length] = mask;
+        pattern->values[pattern->length] = value & mask;
+        pattern->length++;
+
+        return true;
+}
+
+/*
+ * Pack a string two characters to a word, as PUTSP prints them: the first in
+ * the low byte. If skip is set, the string starts in the high byte of its
+ * first word, whatever is in the low byte.
+ */
+
+static bool packString(struct pattern *pattern, char const *string,
+                       size_t length, bool skip)
+{
+        size_t i = 0;
+
+        pattern->length = 0;
+
+        if (skip) {
+                if (!append(pattern, 0xFF00, (uint16_t) (string[i++] << 8))) {
+                        return false;
+                }
+        }
+
+        for (; i + 1 < length; i += 2) {
+                if (!append(pattern, 0xFFFF,
+                            (uint16_t) ((unsigned char) string[i] |
+                                        (unsigned char) string[i + 1] << 8))) {
+                        return false;
+                }
+        }
+
+        // An odd character out says nothing about the byte after it.
+        if (i < length) {
+                return append(pattern, 0x00FF, (unsigned char) string[i]);
+        }
+
+        return true;
+}
+
+/*
+ * A string in quotes, which can be found either a character to a word (as
+ * .STRINGZ stores it) or packed two to a word (as PUTSP wants it).
+ */
+
+static bool parseString(char const *text, struct search *search)
+{
+        char string[2 * SEARCH_LENGTH];
+        size_t length = 0;
+
+        for (text++; '\0' != *text && '"' != *text; text++) {
+                if (sizeof(string) == length) {
+                        return false;
+                }
+
+                if ('\\' == *text && '\0' != text[1]) {
+                        text++;
+                        string[length++] = 'n' == *text ? '\n' :
+                                           't' == *text ? '\t' : *text;
+                } else {
+                        string[length++] = *text;
+                }
+        }
+
+        if (!length) {
+                return false;
+        }
+
+        search->count = 0;
+
+        struct pattern *words = &search->patterns[search->count++];
+        words->length = 0;
+        for (size_t i = 0; i < length; i++) {
+                if (!append(words, 0xFFFF, (unsigned char) string[i])) {
+                        return false;
+                }
+        }
+
+        // A single character packed would match half of every word it's in.
+        if (length > 1) {
+                if (!packString(&search->patterns[search->count++], string,
+                                length, false) ||
+                    !packString(&search->patterns[search->count++], string,
+                                length, true)) {
+                        return false;
+                }
+        }
+
+        return true;
+}
+
+/*
+ * Sixteen binary digits, any of which can be an x to match either, like
+ * "0110 xxx 110 xxxxxx" for an LDR with R6 as its base.
+ */
+
+static bool parseBits(char const *digits, struct search *search)
+{
+        uint16_t mask = 0, value = 0;
+
+        for (int i = 0; i < 16; i++) {
+                mask <<= 1;
+                value <<= 1;
+
+                if ('0' == digits[i] || '1' == digits[i]) {
+                        mask |= 1;
+                        value |= (uint16_t) (digits[i] - '0');
+                } else if ('x' != tolower((unsigned char) digits[i])) {
+                        return false;
+                }
+        }
+
+        search->count = 1;
+        search->patterns[0].length = 0;
+
+        return append(&search->patterns[0], mask, value);
+}
+
+/*
+ * A single word in hex (with or without an x or 0x in front), like the
+ * addresses the memory view jumps to.
+ */
+
+static bool parseWord(char const *digits, struct search *search)
+{
+        unsigned long value = 0;
+        size_t count = 0;
+
+        if ('0' == digits[0] && 'x' == tolower((unsigned char) digits[1])) {
+                digits += 2;
+        } else if ('x' == tolower((unsigned char) digits[0])) {
+                digits++;
+        }
+
+        for (; isxdigit((unsigned char) *digits); digits++, count++) {
+                value = value << 4 | (unsigned long) (isdigit(
+                        (unsigned char) *digits) ?
+                        *digits - '0' :
+                        tolower((unsigned char) *digits) - 'a' + 10);
+        }
+
+        if (!count || count > 4 || '\0' != *digits) {
+                return false;
+        }
+
+        search->count = 1;
+        search->patterns[0].length = 0;
+
+        return append(&search->patterns[0], 0xFFFF, (uint16_t) value);
+}
+
+/*
+ * Work out what to search for from what was typed: a "string", a word in hex,
+ * or sixteen binary digits with x's in. Spaces and underscores between digits
+ * are ignored.
+ *
+ * Returns: false if it's none of those.
+ */
+
+bool parseSearch(char const *text, struct search *search)
+{
+        char digits[SEARCH_LENGTH];
+        size_t count = 0;
+
+        while (isspace((unsigned char) *text)) {
+                text++;
+        }
+
+        if ('"' == *text) {
+                return parseString(text, search);
+        }
+
+        for (; '\0' != *text; text++) {
+                if (isspace((unsigned char) *text) || '_' == *text) {
+                        continue;
+                } else if (sizeof(digits) - 1 == count) {
+                        return false;
+                }
+
+                digits[count++] = *text;
+        }
+
+        digits[count] = '\0';
+
+        return 16 == count ? parseBits(digits, search) :
+                             parseWord(digits, search);
+}
+
+#ifdef __SSE2__
+/*
+ * Compare the words of eight slots (in three registers) with a pattern's
+ * first word, giving a bit for each slot whose value matches.
+ */
+
+static inline unsigned compareSlots(__m128i const chunk[3], __m128i mask,
+                                    __m128i value)
+{
+        unsigned const first = (unsigned) _mm_movemask_epi8(
+                _mm_cmpeq_epi16(_mm_and_si128(chunk[0], mask), value));
+        unsigned const second = (unsigned) _mm_movemask_epi8(
+                _mm_cmpeq_epi16(_mm_and_si128(chunk[1], mask), value));
+        unsigned const third = (unsigned) _mm_movemask_epi8(
+                _mm_cmpeq_epi16(_mm_and_si128(chunk[2], mask), value));
+
+        // The values are words 1, 4 and 7 of the first register, 2 and 5 of
+        // the second, and 0, 3 and 6 of the third, with two bits of each mask
+        // to a word.
+        if (!((first & 0x4104) | (second & 0x0410) | (third & 0x1041))) {
+                return 0;
+        }
+
+        return (first >> 2 & 1)        | (first >> 8 & 1) << 1 |
+               (first >> 14 & 1) << 2  | (second >> 4 & 1) << 3 |
+               (second >> 10 & 1) << 4 | (third & 1) << 5 |
+               (third >> 6 & 1) << 6   | (third >> 12 & 1) << 7;
+}
+#endif
+
+/*
+ * Mark every address whose word matches the first word of each pattern, all
+ * in one pass over memory. The rest of a pattern is left to matches(), as
+ * it's rare to get that far.
+ */
+
+static void findCandidates(struct LC3 const *simulator,
+                           struct search const *search,
+                           uint64_t candidates[][CANDIDATE_WORDS])
+{
+        size_t i = 0;
+
+        memset(candidates, 0,
+               search->count * CANDIDATE_WORDS * sizeof(uint64_t));
+
+#ifdef __SSE2__
+        // Each slot is three words (the address, the value, and the
+        // breakpoint), so eight slots fill three registers. Every word in them
+        // is compared, and the ones that aren't values are ignored afterwards.
+        _Static_assert(6 == sizeof(struct memorySlot) &&
+                       2 == offsetof(struct memorySlot, value),
+                       "The search expects three words to a slot.");
+
+        __m128i masks[SEARCH_PATTERNS], values[SEARCH_PATTERNS];
+
+        for (size_t p = 0; p < search->count; p++) {
+                masks[p] = _mm_set1_epi16(
+                        (short) search->patterns[p].masks[0]);
+                values[p] = _mm_set1_epi16(
+                        (short) search->patterns[p].values[0]);
+        }
+
+        for (; i < WORDS; i += 8) {
+                __m128i const *slots = (__m128i const *) &simulator->memory[i];
+                __m128i const chunk[3] = {
+                        _mm_loadu_si128(slots),
+                        _mm_loadu_si128(slots + 1),
+                        _mm_loadu_si128(slots + 2),
+                };
+
+                for (size_t p = 0; p < search->count; p++) {
+                        candidates[p][i / 64] |= (uint64_t) compareSlots(
+                                chunk, masks[p], values[p]) << (i % 64);
+                }
+        }
+#endif
+
+        for (; i < WORDS; i++) {
+                for (size_t p = 0; p < search->count; p++) {
+                        struct pattern const *pattern = &search->patterns[p];
+
+                        if ((simulator->memory[i].value & pattern->masks[0]) ==
+                            pattern->values[0]) {
+                                candidates[p][i / 64] |=
+                                        (uint64_t) 1 << (i % 64);
+                        }
+                }
+        }
+}
+
+/*
+ * Whether the rest of the pattern follows a word that matched the first of
+ * it. A pattern can't run off the end of memory.
+ */
+
+static bool matches(struct LC3 const *simulator, struct pattern const *pattern,
+                    size_t address)
+{
+        if (address + pattern->length > WORDS) {
+                return false;
+        }
+
+        for (size_t i = 1; i < pattern->length; i++) {
+                if ((simulator->memory[address + i].value & pattern->masks[i]) !=
+                    pattern->values[i]) {
+                        return false;
+                }
+        }
+
+        return true;
+}
+
+/*
+ * The candidates in a word of them that are from first to last (both
+ * included).
+ */
+
+static uint64_t within(uint64_t bits, size_t word, size_t first, size_t last)
+{
+        if (word == first / 64) {
+                bits &= ~(uint64_t) 0 << (first % 64);
+        }
+        if (word == last / 64 && 63 != last % 64) {
+                bits &= ((uint64_t) 1 << (last % 64 + 1)) - 1;
+        }
+
+        return bits;
+}
+
+/*
+ * The first match from first to last, or -1 if there isn't one.
+ */
+
+static long firstMatch(struct LC3 const *simulator,
+                       struct pattern const *pattern,
+                       uint64_t const *candidates, size_t first, size_t last)
+{
+        for (size_t word = first / 64; word <= last / 64; word++) {
+                for (uint64_t bits = within(candidates[word], word, first, last);
+                     bits; bits &= bits - 1) {
+                        size_t const address =
+                                word * 64 + (size_t) __builtin_ctzll(bits);
+
+                        if (matches(simulator, pattern, address)) {
+                                return (long) address;
+                        }
+                }
+        }
+
+        return -1;
+}
+
+/*
+ * The last match from first to last, or -1 if there isn't one.
+ */
+
+static long lastMatch(struct LC3 const *simulator,
+                      struct pattern const *pattern,
+                      uint64_t const *candidates, size_t first, size_t last)
+{
+        for (size_t word = last / 64 + 1; word-- > first / 64;) {
+                for (uint64_t bits = within(candidates[word], word, first, last);
+                     bits; bits &= ~((uint64_t) 1 << (63 - __builtin_clzll(bits)))) {
+                        size_t const address =
+                                word * 64 + 63 - (size_t) __builtin_clzll(bits);
+
+                        if (matches(simulator, pattern, address)) {
+                                return (long) address;
+                        }
+                }
+        }
+
+        return -1;
+}
+
+/*
+ * Find the next match after the given address (or the one before it, if not
+ * forward), going round to the other end of memory if need be. The address
+ * itself is only found if it's the only match there is.
+ *
+ * Returns: The address of the match, or -1 if there is none.
+ */
+
+long searchMemory(struct LC3 const *simulator, struct search const *search,
+                  uint16_t from, bool forward)
+{
+        uint64_t candidates[SEARCH_PATTERNS][CANDIDATE_WORDS];
+        long best = -1;
+        unsigned long bestDistance = WORDS;
+
+        findCandidates(simulator, search, candidates);
+
+        for (size_t i = 0; i < search->count; i++) {
+                struct pattern const *pattern = &search->patterns[i];
+                long found;
+
+                if (forward) {
+                        found = 0xFFFF == from ? -1 :
+                                firstMatch(simulator, pattern, candidates[i],
+                                           from + 1u, 0xFFFF);
+                        if (-1 == found) {
+                                found = firstMatch(simulator, pattern,
+                                                   candidates[i], 0, from);
+                        }
+                } else {
+                        found = 0 == from ? -1 :
+                                lastMatch(simulator, pattern, candidates[i], 0,
+                                          from - 1u);
+                        if (-1 == found) {
+                                found = lastMatch(simulator, pattern,
+                                                  candidates[i], from,
+                                                  0xFFFF);
+                        }
+                }
+
+                if (-1 == found) {
+                        continue;
+                }
+
+                // How far it is, going the way we're searching.
+                unsigned long const distance = (forward ?
+                        (unsigned long) found - from - 1 :
+                        (unsigned long) from - (unsigned long) found - 1) &
+                        (WORDS - 1);
+
+                if (distance < bestDistance) {
+                        best = found;
+                        bestDistance = distance;
+                }
+        }
+
+        return best;
+}
@@ -0,0 +1,504 @@
+#ifdef __linux__
+#define _XOPEN_SOURCE 700
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "Worker.h"
+#include "LC3.h"
+#include "Memory.h"
+
+// How many instructions are run between looking for commands.
+#define BATCH 4096
+
+#define COMMANDS  256
+#define OUTPUT    0x10000
+#define SNAPSHOTS 8
+
+/*
+ * Give the other side a moment to make room in a queue.
+ */
+
+static void nap(void)
+{
+        struct timespec const pause = {.tv_sec = 0, .tv_nsec = 1000000};
+
+        nanosleep(&pause, NULL);
+}
+
+static bool stopping(struct worker *worker)
+{
+        return atomic_load_explicit(&worker->stopping, memory_order_acquire);
+}
+
+/*
+ * Sleep until the interface sends another command, or wants us gone.
+ */
+
+static void doze(struct worker *worker)
+{
+        pthread_mutex_lock(&worker->lock);
+        while (!worker->woken && !stopping(worker)) {
+                pthread_cond_wait(&worker->wake, &worker->lock);
+        }
+        worker->woken = false;
+        pthread_mutex_unlock(&worker->lock);
+}
+
+static void rouse(struct worker *worker)
+{
+        pthread_mutex_lock(&worker->lock);
+        worker->woken = true;
+        pthread_cond_signal(&worker->wake);
+        pthread_mutex_unlock(&worker->lock);
+}
+
+static bool running(struct LC3 const *simulator)
+{
+        return !simulator->isPaused && !simulator->isHalted;
+}
+
+/*
+ * Copy the memory around the PC into a snapshot, starting early enough near
+ * the end of memory that there's always LIVE_WORDS of it.
+ */
+
+static void copyMemory(struct snapshot *snapshot, struct LC3 const *simulator)
+{
+        uint16_t const first = simulator->PC > 0x10000 - LIVE_WORDS ?
+                               0x10000 - LIVE_WORDS : simulator->PC;
+        struct memorySlot const *slot = &simulator->memory[first];
+
+        snapshot->first = first;
+        memset(snapshot->breakpoints, 0, sizeof(snapshot->breakpoints));
+
+        for (size_t i = 0; i < LIVE_WORDS; i++) {
+                snapshot->words[i] = slot[i].value;
+                snapshot->breakpoints[i / 64] |=
+                        (uint64_t) slot[i].isBreakpoint << (i % 64);
+        }
+}
+
+/*
+ * Tell the interface how the machine is now. A snapshot only has to be sent
+ * when it's the last one before we go to sleep; while the machine is running
+ * there'll be another along in a moment, so it's skipped if there's no room.
+ */
+
+static void publish(struct worker *worker, bool force)
+{
+        struct LC3 const *simulator = &worker->program->simulator;
+
+        if (!force && queueFull(&worker->snapshots)) {
+                return;
+        }
+
+        struct snapshot snapshot = {
+                .PC             = simulator->PC,
+                .IR             = simulator->IR,
+                .CC             = simulator->CC,
+                .isHalted       = simulator->isHalted,
+                .isPaused       = simulator->isPaused,
+                .state          = worker->reading ? WORKER_READING :
+                                  running(simulator) ? WORKER_RUNNING :
+                                  WORKER_IDLE,
+                .processed      = worker->processed,
+                .breakpointsHit = worker->breakpointsHit,
+        };
+
+        memcpy(snapshot.registers, simulator->registers,
+               sizeof(snapshot.registers));
+        copyMemory(&snapshot, simulator);
+
+        while (!pushQueue(&worker->snapshots, &snapshot)) {
+                if (!force || stopping(worker)) {
+                        return;
+                }
+                nap();
+        }
+
+        worker->changed = false;
+}
+
+/*
+ * Stop the machine if it's about to run an instruction with a breakpoint on
+ * it. Like a breakpoint set in the debugger, it only stops the machine once.
+ */
+
+static bool atBreakpoint(struct worker *worker)
+{
+        struct LC3 *simulator = &worker->program->simulator;
+
+        if (!simulator->memory[simulator->PC].isBreakpoint) {
+                return false;
+        }
+
+        simulator->memory[simulator->PC].isBreakpoint = false;
+        markDirty(simulator, simulator->PC);
+        simulator->isPaused = true;
+        worker->breakpointsHit++;
+
+        return true;
+}
+
+static void obey(struct worker *, struct command const *);
+
+/*
+ * The keyboard, for the machine, is whatever the interface sends as input.
+ * While we wait for it, anything that doesn't need the instruction to finish
+ * first is done straight away. A reset does, so it gives up on the key and
+ * waits for the end of the instruction.
+ */
+
+static int workerRead(void *data)
+{
+        struct worker *worker = data;
+        struct command command;
+        int c = EOF;
+
+        worker->reading = true;
+        publish(worker, true);
+
+        while (!stopping(worker)) {
+                if (!popQueue(&worker->commands, &command)) {
+                        doze(worker);
+                        continue;
+                }
+
+                if (COMMAND_INPUT == command.type) {
+                        worker->processed++;
+                        c = (int) command.value;
+                        break;
+                } else if (COMMAND_RESET == command.type) {
+                        worker->deferred = true;
+                        worker->later = command;
+                        break;
+                } else if (COMMAND_STEP == command.type ||
+                           COMMAND_STEP_OVER == command.type) {
+                        // We're already in the middle of one.
+                        worker->processed++;
+                } else {
+                        obey(worker, &command);
+                }
+
+                publish(worker, true);
+        }
+
+        worker->reading = false;
+        worker->changed = true;
+
+        return c;
+}
+
+/*
+ * Anything printed waits for the interface to make room for it, as it'd be a
+ * shame to lose it.
+ */
+
+static void workerWrite(void *data, char c)
+{
+        struct worker *worker = data;
+
+        while (!pushQueue(&worker->output, &c) && !stopping(worker)) {
+                nap();
+        }
+}
+
+static void stepOnce(struct worker *worker)
+{
+        struct console const console = {
+                .read  = workerRead,
+                .write = workerWrite,
+                .data  = worker,
+        };
+
+        step(&worker->program->simulator, &console);
+
+        if (worker->deferred) {
+                worker->deferred = false;
+                obey(worker, &worker->later);
+        }
+}
+
+static bool isCall(uint16_t IR)
+{
+        return JSR == (IR & 0xF000) || TRAP == (IR & 0xF000);
+}
+
+static bool isReturn(uint16_t IR)
+{
+        return (JMP == (IR & 0xF000) && 7 == (IR >> 6 & 7)) ||
+               RTI == (IR & 0xF000);
+}
+
+/*
+ * Start the machine running towards the given target.
+ */
+
+static void aim(struct worker *worker, struct target const *target)
+{
+        worker->target = *target;
+        worker->target.set = true;
+        worker->program->simulator.isPaused =
+                worker->program->simulator.isHalted;
+}
+
+static void obey(struct worker *worker, struct command const *command)
+{
+        struct LC3 *simulator = &worker->program->simulator;
+        uint16_t const IR = simulator->memory[simulator->PC].value;
+
+        // Counted first, so that a snapshot sent while a step waits for a
+        // key already includes the step.
+        worker->processed++;
+        worker->changed = true;
+
+        switch (command->type) {
+        case COMMAND_STEP_OVER:
+                if (isCall(IR)) {
+                        aim(worker, &(struct target) {
+                                .hasAddress = true,
+                                .address    = (uint16_t) (simulator->PC + 1),
+                                .sameFrame  = true,
+                        });
+                        break;
+                }
+                // Anything else is just a step, so...
+                // fall through
+        case COMMAND_STEP:
+                stepOnce(worker);
+                simulator->isPaused = true;
+                atBreakpoint(worker);
+                break;
+        case COMMAND_STEP_OUT:
+                aim(worker, &(struct target) {.onReturn = true});
+                break;
+        case COMMAND_RUN_TO:
+                aim(worker, &(struct target) {
+                        .hasAddress = true,
+                        .address    = command->address,
+                });
+                break;
+        case COMMAND_RUN_FOR:
+                if (command->value) {
+                        aim(worker, &(struct target) {
+                                .remaining = command->value,
+                        });
+                }
+                break;
+        case COMMAND_RUN:
+                worker->target.set = false;
+                simulator->isPaused = simulator->isHalted;
+                break;
+        case COMMAND_PAUSE:
+                simulator->isPaused = true;
+                break;
+        case COMMAND_RESET:
+                resetMachine(worker->program);
+                break;
+        case COMMAND_TOGGLE_BREAKPOINT:
+                simulator->memory[command->address].isBreakpoint =
+                        !simulator->memory[command->address].isBreakpoint;
+                markDirty(simulator, command->address);
+                break;
+        case COMMAND_WRITE:
+                writeMemory(simulator, command->address,
+                            (uint16_t) command->value);
+                break;
+        case COMMAND_SET_PC:
+                simulator->PC = command->address;
+                break;
+        case COMMAND_INPUT:
+                // Nothing is waiting for it any more.
+                break;
+        default:
+                break;
+        }
+}
+
+/*
+ * Run a batch of instructions, like any other run, but watching each one for
+ * the target. This is the slower of the two, so only used when there is one.
+ */
+
+static void runToTarget(struct worker *worker)
+{
+        struct LC3 *simulator = &worker->program->simulator;
+        struct target *target = &worker->target;
+
+        for (int i = 0; i < BATCH && running(simulator) &&
+             !atBreakpoint(worker); i++) {
+                uint16_t const IR = simulator->memory[simulator->PC].value;
+
+                stepOnce(worker);
+
+                if (isCall(IR)) {
+                        target->depth++;
+                } else if (isReturn(IR)) {
+                        target->depth--;
+                }
+
+                if ((target->onReturn && target->depth < 0) ||
+                    (target->hasAddress &&
+                     target->address == simulator->PC &&
+                     (!target->sameFrame || !target->depth)) ||
+                    (target->remaining && !--target->remaining)) {
+                        simulator->isPaused = true;
+                }
+        }
+}
+
+static void *simulate(void *data)
+{
+        struct worker *worker = data;
+        struct LC3 *simulator = &worker->program->simulator;
+        struct command command;
+
+        while (!stopping(worker)) {
+                while (popQueue(&worker->commands, &command)) {
+                        obey(worker, &command);
+                }
+
+                if (running(simulator) && worker->target.set) {
+                        runToTarget(worker);
+                        worker->changed = true;
+                        publish(worker, false);
+                } else if (running(simulator)) {
+                        for (int i = 0; i < BATCH && running(simulator) &&
+                             !atBreakpoint(worker); i++) {
+                                stepOnce(worker);
+                        }
+
+                        worker->changed = true;
+                        publish(worker, false);
+                } else {
+                        // However it stopped, the target is no more.
+                        worker->target.set = false;
+
+                        if (worker->changed) {
+                                publish(worker, true);
+                        }
+
+                        doze(worker);
+                }
+        }
+
+        return NULL;
+}
+
+/*
+ * Start running the program on a thread of its own. Until the worker is
+ * stopped, nothing but the worker may touch the program's simulator, except
+ * to read it once workerSettled() says nothing is happening to it.
+ */
+
+void startWorker(struct worker *worker, struct program *program)
+{
+        struct LC3 const *simulator = &program->simulator;
+
+        *worker = (struct worker) {
+                .program = program,
+                .changed = true,
+                .latest  = {
+                        .PC       = simulator->PC,
+                        .IR       = simulator->IR,
+                        .CC       = simulator->CC,
+                        .isHalted = simulator->isHalted,
+                        .isPaused = simulator->isPaused,
+                        .state    = running(simulator) ? WORKER_RUNNING :
+                                    WORKER_IDLE,
+                },
+        };
+
+        memcpy(worker->latest.registers, simulator->registers,
+               sizeof(worker->latest.registers));
+        copyMemory(&worker->latest, simulator);
+
+        initQueue(&worker->commands, sizeof(struct command), COMMANDS);
+        initQueue(&worker->output, sizeof(char), OUTPUT);
+        initQueue(&worker->snapshots, sizeof(struct snapshot), SNAPSHOTS);
+        atomic_init(&worker->stopping, false);
+        pthread_mutex_init(&worker->lock, NULL);
+        pthread_cond_init(&worker->wake, NULL);
+
+        if (pthread_create(&worker->thread, NULL, simulate, worker)) {
+                perror("LC3-Simulator");
+                exit(EXIT_FAILURE);
+        }
+}
+
+/*
+ * Stop the worker, leaving the program as it was at the end of the last
+ * instruction. Anything it printed that hasn't been read is lost.
+ */
+
+void stopWorker(struct worker *worker)
+{
+        atomic_store_explicit(&worker->stopping, true, memory_order_release);
+        rouse(worker);
+        pthread_join(worker->thread, NULL);
+
+        pthread_cond_destroy(&worker->wake);
+        pthread_mutex_destroy(&worker->lock);
+        freeQueue(&worker->commands);
+        freeQueue(&worker->output);
+        freeQueue(&worker->snapshots);
+}
+
+void sendCommand(struct worker *worker, enum COMMAND type, uint16_t address,
+                 uint32_t value)
+{
+        struct command const command = {
+                .type    = type,
+                .address = address,
+                .value   = value,
+        };
+
+        while (!pushQueue(&worker->commands, &command)) {
+                nap();
+        }
+
+        worker->sent++;
+        rouse(worker);
+}
+
+/*
+ * Returns: false if the worker hasn't printed anything since last time.
+ */
+
+bool readOutput(struct worker *worker, char *c)
+{
+        return popQueue(&worker->output, c);
+}
+
+/*
+ * Catch up with the worker, keeping only the latest of its snapshots.
+ *
+ * Returns: false if there was nothing new.
+ */
+
+bool takeSnapshot(struct worker *worker)
+{
+        bool taken = false;
+
+        while (popQueue(&worker->snapshots, &worker->latest)) {
+                taken = true;
+        }
+
+        return taken;
+}
+
+/*
+ * Returns: true if the latest snapshot came after every command sent, and
+ * the machine isn't running, so that nothing will change until it's sent
+ * another.
+ */
+
+bool workerSettled(struct worker const *worker)
+{
+        return worker->latest.processed == worker->sent &&
+               WORKER_RUNNING != worker->latest.state;
+}
@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "Parser.h"
+#include "Structs.h"
+
+/*
+ * What the assembler has to say about labels is only known once it has seen
+ * all of them, but it still has to come out in line order, among everything
+ * else.
+ */
+
+static char directory[] = "/tmp/lc3diagXXXXXX";
+
+static char const source[] =
+        ".ORIG x3000\n"
+        "BR NOWHERE\n"                  // Line 2: no such label.
+        "LD R0, FAR\n"                  // Line 3: the label is out of reach.
+        "ADD R0, R0, #1\n"
+        "ADD R9, R0, #1\n"              // Line 5: no such register.
+        "LEA R1, NOWHERE_ELSE\n"        // Line 6: no such label.
+        "HALT\n"
+        ".BLKW 140\n"
+        ".BLKW 140\n"
+        ".BLKW 140\n"
+        "FAR .FILL 1\n"
+        ".END\n";
+
+// Where each error should be, in the order they should be in.
+static char const *const expected[] = {
+        "Line   2: Invalid label",
+        "Line   3: Label is too far away",
+        "Line   5: Invalid operand",
+        "Line   6: Invalid label",
+};
+
+static char *pathFor(char const *extension)
+{
+        size_t length = strlen(directory) + strlen(extension) + 8;
+        char *path = malloc(length);
+
+        if (NULL == path) {
+                perror("Diagnostics");
+                exit(EXIT_FAILURE);
+        }
+
+        snprintf(path, length, "%s/test%s", directory, extension);
+
+        return path;
+}
+
+int main(void)
+{
+        struct program program;
+        char *messages = NULL, *at;
+        size_t size = 0;
+        int failures = 0;
+        FILE *file;
+
+        if (NULL == mkdtemp(directory)) {
+                perror("Diagnostics");
+                return EXIT_FAILURE;
+        }
+
+        program = (struct program) {
+                .assemblyfile = pathFor(".asm"),
+                .objectfile   = pathFor(".obj"),
+                .symbolfile   = pathFor(".sym"),
+                .hexoutfile   = pathFor(".hex"),
+                .binoutfile   = pathFor(".bin"),
+                .messages     = open_memstream(&messages, &size),
+        };
+
+        file = fopen(program.assemblyfile, "w");
+        if (NULL == file || NULL == program.messages) {
+                perror("Diagnostics");
+                return EXIT_FAILURE;
+        }
+        fputs(source, file);
+        fclose(file);
+
+        if (parse(&program)) {
+                fputs("Assembled a program with errors in it.\n", stderr);
+                failures++;
+        }
+
+        fclose(program.messages);
+
+        at = messages;
+        for (size_t i = 0; i < sizeof(expected) / sizeof(*expected); i++) {
+                char *found = strstr(at, expected[i]);
+
+                if (NULL == found) {
+                        fprintf(stderr, "Expected \"%s\" after:\n%s\n",
+                                expected[i], at);
+                        failures++;
+                        continue;
+                }
+
+                at = found;
+        }
+
+        if (failures) {
+                fprintf(stderr, "The assembler said:\n%s", messages);
+        }
+
+        freeTable(&program);
+        free(messages);
+        unlink(program.assemblyfile);
+        rmdir(directory);
+        free(program.assemblyfile);
+        free(program.objectfile);
+        free(program.symbolfile);
+        free(program.hexoutfile);
+        free(program.binoutfile);
+
+        return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
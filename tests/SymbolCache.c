@@ -0,0 +1,133 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "Parser.h"
+#include "Structs.h"
+
+/*
+ * A table loaded from a symbol cache keeps using the cache's memory for its
+ * names, so assembling the program again while the table is still around
+ * mustn't pull that memory out from under it.
+ */
+
+#define LABELS 500
+
+static char directory[] = "/tmp/lc3symcXXXXXX";
+
+static char *pathFor(char const *extension)
+{
+        size_t length = strlen(directory) + strlen(extension) + 8;
+        char *path = malloc(length);
+
+        if (NULL == path) {
+                perror("SymbolCache");
+                exit(EXIT_FAILURE);
+        }
+
+        snprintf(path, length, "%s/test%s", directory, extension);
+
+        return path;
+}
+
+static void writeSource(char const *fileName, int labels)
+{
+        FILE *file = fopen(fileName, "w");
+
+        if (NULL == file) {
+                perror("SymbolCache");
+                exit(EXIT_FAILURE);
+        }
+
+        fputs(".ORIG x3000\n", file);
+        for (int i = 0; i < labels; i++) {
+                fprintf(file, "A_RATHER_LONG_LABEL_NUMBER_%04d ADD R0, R0, #1\n",
+                        i);
+        }
+        fputs("HALT\n.END\n", file);
+
+        fclose(file);
+}
+
+static struct program programFor(void)
+{
+        return (struct program) {
+                .assemblyfile = pathFor(".asm"),
+                .objectfile   = pathFor(".obj"),
+                .symbolfile   = pathFor(".sym"),
+                .hexoutfile   = pathFor(".hex"),
+                .binoutfile   = pathFor(".bin"),
+                .messages     = fopen("/dev/null", "w"),
+        };
+}
+
+static void forget(struct program *program)
+{
+        freeTable(program);
+        fclose(program->messages);
+        free(program->assemblyfile);
+        free(program->objectfile);
+        free(program->symbolfile);
+        free(program->hexoutfile);
+        free(program->binoutfile);
+}
+
+static void assemble(int labels)
+{
+        struct program program = programFor();
+
+        writeSource(program.assemblyfile, labels);
+        if (!parse(&program)) {
+                fprintf(stderr, "Couldn't assemble %d labels.\n", labels);
+                exit(EXIT_FAILURE);
+        }
+
+        forget(&program);
+}
+
+int main(void)
+{
+        struct program loaded;
+        char expected[64];
+        int failures = 0;
+
+        if (NULL == mkdtemp(directory)) {
+                perror("SymbolCache");
+                return EXIT_FAILURE;
+        }
+
+        assemble(LABELS);
+
+        loaded = programFor();
+        populateSymbolsFromFile(&loaded);
+
+        // The cache is written again, far shorter than it was.
+        assemble(1);
+
+        for (int i = 0; i < LABELS; i++) {
+                struct symbol const *symbol =
+                        findSymbolByAddress(&loaded, (uint16_t) (0x3000 + i));
+
+                snprintf(expected, sizeof(expected),
+                         "A_RATHER_LONG_LABEL_NUMBER_%04d", i);
+                if (NULL == symbol || strcmp(symbol->name, expected)) {
+                        fprintf(stderr, "Lost the symbol at x%04X.\n",
+                                0x3000 + i);
+                        failures++;
+                }
+        }
+
+        forget(&loaded);
+
+        char const *extensions[] = {".asm", ".obj", ".sym", ".symc", ".hex",
+                                    ".bin"};
+        for (size_t i = 0; i < sizeof(extensions) / sizeof(*extensions); i++) {
+                char *path = pathFor(extensions[i]);
+                unlink(path);
+                free(path);
+        }
+        rmdir(directory);
+
+        return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}